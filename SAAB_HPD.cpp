@@ -1,12 +1,34 @@
 #include <SAAB_HPD.h>
+#include <SAAB_HPD_Journal.h>
+#include <SAAB_HPD_Heatmap.h>
+#include <SAAB_HPD_Pcapng.h>
 
 // SAAB_HPD class implementation
 
 SAAB_HPD::SAAB_HPD(HardwareSerial &serial) 
-    : SIDSerial(serial), printDebug(false), bufferIndex(0), expectedLength(0), syncFound(false), frameCallback(nullptr), currentMode(MODE_UNKNOWN) {}
+    : SIDSerial(serial), printDebug(false), bufferIndex(0), expectedLength(0), syncFound(false), syncIndex(0), syncPatternData(syncPattern), syncPatternSize(syncPatternLength), frameCallback(nullptr),
+      eventCallback(nullptr), eventCount(0), eventsDropped(0), dedupPolicy(DEDUP_OFF), dedupHits(0), dedupMisses(0), currentFrameDuplicate(false),
+      frameRing(nullptr), frameRingHead(0), journal(nullptr), heatmap(nullptr), pcapng(nullptr),
+      forensicCapture(false), rawHistoryPos(0), rawHistoryFill(0), parseFailureHead(0), parseFailureCount(0), parseFailureTotal(0), collectingAfter(nullptr),
+      ackPending(false), ackCommand(0x00), ackDone(nullptr), ackDoneContext(nullptr), ackSentAt(0), ackTimer(0),
+      busShare(100), txTokens(0), txTokensUpdated(0), txWindowStart(0), txWindowTimer(0),
+      echoCheck(false), echoMaxRetries(3), echoTimeoutMicros(2000),
+      txLength(0), txOffset(0), txEchoOffset(0), txClassInFlight(TX_CLASS_OTHER), txAttempts(0),
+      txPaced(false), txEchoVerify(false), txExpectsAck(false), txDone(nullptr), txDoneContext(nullptr), txThrottled(false), txThrottleStart(0), txEchoActivity(0), rxActivity(0),
+      currentMode(MODE_UNKNOWN) {
+    resetTxStats();
+    memset(dedupCache, 0, sizeof(dedupCache));
+    memset(frameConsumers, 0, sizeof(frameConsumers));
+}
+
+SAAB_HPD::~SAAB_HPD() {
+    free(frameRing);
+}
 
 void SAAB_HPD::begin(uint8_t rxPin, uint8_t txPin) {
-    SIDSerial.begin(115200, SERIAL_8N1, rxPin, txPin);
+    SIDSerial.begin(SID_BAUD_RATE, SERIAL_8N1, rxPin, txPin);
+    txTokensUpdated = micros();
+    resetTxStats();
 }
 
 void SAAB_HPD::setDebug(bool enable) {
@@ -32,29 +54,118 @@ void SAAB_HPD::toggleDebug() {
   * @param frame 
       The SerialFrame structure containing the data to be sent.
   * @return ERROR
-      ERROR_OK for success, ERROR_TIMEOUT for timeout, or error code for failure.
+      ERROR_OK for success, ERROR_TIMEOUT for timeout, ERROR_COLLISION if every attempt collided, or error code for failure.
   
   * @note The function sends the frame data and waits for acknowledgment or error response.
+  * @note With echo check enabled a collided frame is sent again right away instead of waiting for the ACK timeout.
 !*/
 SAAB_HPD::ERROR SAAB_HPD::sendSidData(SerialFrame &frame) {
-    // Calculate DLC if not already set
-    if (frame.dlc == 0) {
-        frame.dlc = 2 + strlen(reinterpret_cast<const char*>(frame.data)); // Command + padding + data length
+    completeFrame(frame);
+    return sendPreparedSidData(frame);
+}
+
+/*!
+  * @brief Send a frame whose DLC and checksum are already set and wait for acknowledgment or error code.
+  * @param frame 
+      Complete frame, e.g. from a build* encoder, SAAB_HPD_Writer or a cache. Sent as is.
+  * @return ERROR
+      Same as sendSidData.
+!*/
+SAAB_HPD::ERROR SAAB_HPD::sendPreparedSidData(const SerialFrame &frame) {
+    // Wait for a frame queued with queueSidData to leave the TX slot
+    SendResult result = {false, ERROR_TIMEOUT};
+    while (!queuePreparedSidData(frame, onSendDone, &result)) {
+        serviceTx();
+        yield();
     }
+    return completeSend(result);
+}
 
-    // Calculate checksum
-    frame.checksum = calculateChecksum(frame);
+/*!
+  * @brief Send the wire bytes of a complete frame and wait for acknowledgment or error code.
+  * @param bytes 
+      DLC, command, padding, data and checksum, e.g. from serializeFrame or SAAB_HPD_FrameCache.
+  * @param len 
+      Number of bytes, at most BUFFER_SIZE + 2.
+  * @return ERROR
+      Same as sendSidData.
+!*/
+SAAB_HPD::ERROR SAAB_HPD::sendEncodedSidData(const uint8_t* bytes, size_t len) {
+    SendResult result = {false, ERROR_TIMEOUT};
+    while (!queueEncodedSidData(bytes, len, onSendDone, &result)) {
+        serviceTx();
+        yield();
+    }
+    return completeSend(result);
+}
 
-    // Send the frame
-    SIDSerial.write(frame.dlc);
-    SIDSerial.write(frame.command);
-    if (frame.dlc >= 2) {
-        SIDSerial.write(0x00); // Send padding byte
+// Writes out the queued frame and waits for its answer
+SAAB_HPD::ERROR SAAB_HPD::completeSend(SendResult &result) {
+    while (!result.done) {
+        serviceTx();
+        yield();
+    }
+    return result.result;
+}
+
+void SAAB_HPD::onSendDone(void* context, ERROR result) {
+    SendResult* send = static_cast<SendResult*>(context);
+    send->done = true;
+    send->result = result;
+}
+
+void SAAB_HPD::serviceTx() {
+    pumpTx();
+    if (!rxIsEcho()) {
+        SerialFrame frame;
+        while (readSIDserialData(frame)) {
+            dispatchFrame(frame); // Answers are matched to their frames here
+        }
     }
-    for (byte i = 0; i < frame.dlc - 2; i++) {
-        SIDSerial.write(frame.data[i]);
+    if (ackPending && timers.now() - ackSentAt >= SID_ACK_TIMEOUT_MS) {
+        finishAnswer(ERROR_TIMEOUT);
+    }
+}
+
+/*!
+  * @brief Queue SID data for sending without waiting.
+  * @param frame 
+      The SerialFrame structure containing the data to be sent, DLC and checksum are completed like in sendSidData.
+  * @param done 
+      Called once with the outcome of this frame, nullptr for none.
+  * @param context 
+      Passed to done.
+  * @return true if the frame was queued, false if the previous frame is still being sent
+      or waiting for its answer.
+  
+  * @note The bytes are written from poll() as the UART TX FIFO has room, the call never blocks.
+  * @note The ACK/error response arrives through poll() like any other frame, and as EVENT_ACK, EVENT_NACK or EVENT_TIMEOUT.
+  * @note done runs from poll() (or from a blocking send), it may queue the next frame.
+  * @note One frame at a time: the line is half-duplex and the SID answers every frame, so the next one
+  *       waits for the answer or SID_ACK_TIMEOUT_MS instead of colliding with it.
+!*/
+bool SAAB_HPD::queueSidData(SerialFrame &frame, TxDoneCallback done, void* context) {
+    if (isTxBusy()) {
+        return false; // Previous frame still in flight
+    }
+    completeFrame(frame);
+    return queuePreparedSidData(frame, done, context);
+}
+
+/*!
+  * @brief Queue a frame whose DLC and checksum are already set.
+  * @param frame 
+      Complete frame, sent as is.
+  * @param done 
+      Called once with the outcome of this frame, nullptr for none.
+  * @param context 
+      Passed to done.
+  * @return true if the frame was queued, false like queueSidData.
+!*/
+bool SAAB_HPD::queuePreparedSidData(const SerialFrame &frame, TxDoneCallback done, void* context) {
+    if (isTxBusy()) {
+        return false; // Previous frame still in flight
     }
-    SIDSerial.write(frame.checksum);
 
     if (printDebug) {
         Serial.println("\n--- Frame Sent ---");
@@ -67,20 +178,40 @@ SAAB_HPD::ERROR SAAB_HPD::sendSidData(SerialFrame &frame) {
         Serial.println("------------------");
     }
 
-    // Wait for acknowledgment or error response
-    SerialFrame responseFrame;
-    unsigned long startTime = millis();
-    while (millis() - startTime < 100) { // Timeout after 100ms
-        if (readSIDserialData(responseFrame)) {
-            if (responseFrame.command == 0xFF && responseFrame.dlc == 0x02) {
-                return ERROR_OK; // Success
-            } else if (responseFrame.command == 0xFE) {
-                return static_cast<ERROR>(responseFrame.data[0]); // Return error code
-            }
-        }
+    startTx(serializeFrame(frame, txBuffer), commandClass(frame.command));
+    txExpectsAck = true;
+    txDone = done;
+    txDoneContext = context;
+    return true;
+}
+
+/*!
+  * @brief Queue the wire bytes of a complete frame.
+  * @param bytes 
+      DLC, command, padding, data and checksum, copied into the TX slot.
+  * @param len 
+      Number of bytes, at most BUFFER_SIZE + 2.
+  * @param done 
+      Called once with the outcome of this frame, nullptr for none.
+  * @param context 
+      Passed to done.
+  * @return true if the frame was queued, false like queueSidData or if len does not fit.
+!*/
+bool SAAB_HPD::queueEncodedSidData(const uint8_t* bytes, size_t len, TxDoneCallback done, void* context) {
+    if (isTxBusy() || len < 2 || len > sizeof(txBuffer)) {
+        return false;
     }
 
-    return ERROR_TIMEOUT; // Timeout or no valid response
+    memcpy(txBuffer, bytes, len);
+    startTx(len, commandClass(bytes[1]));
+    txExpectsAck = true;
+    txDone = done;
+    txDoneContext = context;
+    return true;
+}
+
+bool SAAB_HPD::isTxBusy() {
+    return txLength != 0 || ackPending;
 }
 
 /*!
@@ -101,7 +232,287 @@ void SAAB_HPD::sendSidRawData(size_t len, byte* data) {
         }
         Serial.println("\n");
     }
-    SIDSerial.write(data, len);
+
+    // Send through the TX slot in chunks of its size
+    size_t sent = 0;
+    while (sent < len) {
+        while (isTxBusy()) {
+            serviceTx();
+            yield();
+        }
+        size_t chunk = len - sent;
+        if (chunk > sizeof(txBuffer)) chunk = sizeof(txBuffer);
+        memcpy(txBuffer, &data[sent], chunk);
+        startTx(chunk, TX_CLASS_RAW);
+        while (txLength != 0) {
+            serviceTx();
+            yield();
+        }
+        sent += chunk;
+    }
+}
+
+/*!
+  * @brief Set the share of the bus capacity our TX path may use.
+  * @param percent 
+      1-100 % of SID_BUS_BYTES_PER_SECOND. 100 disables pacing.
+  * @return void
+  
+  * @note The bus is shared with the ICM, bursts of our updates delay its frames and trigger its retries.
+  * @note The bucket holds one maximum size frame, so a single frame is never split by the pacer.
+!*/
+void SAAB_HPD::setBusShare(uint8_t percent) {
+    if (percent == 0) percent = 1;
+    if (percent > 100) percent = 100;
+    busShare = percent;
+    txTokens = BUFFER_SIZE + 2; // Start with a full bucket
+    txTokensUpdated = micros();
+}
+
+uint8_t SAAB_HPD::getBusShare() {
+    return busShare;
+}
+
+const SAAB_HPD::TxStats& SAAB_HPD::getTxStats() {
+    return txStats;
+}
+
+void SAAB_HPD::resetTxStats() {
+    memset(&txStats, 0, sizeof(txStats));
+    memset(txWindowFrames, 0, sizeof(txWindowFrames));
+    memset(txWindowBytes, 0, sizeof(txWindowBytes));
+    txWindowStart = timers.now();
+
+    // Per second rates are published by a repeating timer, started by the next frame sent
+    timers.cancel(txWindowTimer);
+    txWindowTimer = 0;
+}
+
+SAAB_HPD::TX_CLASS SAAB_HPD::commandClass(uint8_t command) {
+    switch (command) {
+        case 0x10: return TX_CLASS_REGION_SETUP;
+        case 0x11: return TX_CLASS_REGION_UPDATE;
+        case 0x60:
+        case 0x70: return TX_CLASS_REGION_DRAW;
+        case 0x40: return TX_CLASS_RAW;
+        default: return TX_CLASS_OTHER;
+    }
+}
+
+/*!
+  * @brief Enable or disable echo verification of transmitted bytes.
+  * @param enable 
+      true to compare every sent byte with its echo.
+  * @param maxRetries 
+      How many times a collided frame is resent before it is dropped.
+  * @param echoTimeoutMicros 
+      Time allowed for a written byte to come back, a byte takes about 87 us on the wire.
+  * @return void
+  
+  * @note While enabled only a few bytes are written ahead of the verified echo, so a collision aborts the frame after a few byte times.
+  * @note If the echo does not arrive in time the rest of the frame is sent unverified and counted in echoTimeouts.
+  * @note A collided frame is sent again once RX has been quiet for SID_LINE_IDLE_MICROS. A dropped frame is reported
+  *       as EVENT_COLLISION and ERROR_COLLISION.
+!*/
+void SAAB_HPD::setEchoCheck(bool enable, uint8_t maxRetries, uint16_t echoTimeoutMicros) {
+    echoCheck = enable;
+    echoMaxRetries = maxRetries;
+    this->echoTimeoutMicros = echoTimeoutMicros;
+}
+
+void SAAB_HPD::startTx(size_t len, TX_CLASS txClass) {
+    txLength = len;
+    txOffset = 0;
+    txEchoOffset = 0;
+    txClassInFlight = txClass;
+    txAttempts = 0;
+    txPaced = false;
+    txEchoVerify = echoCheck;
+    txExpectsAck = false;
+    txDone = nullptr;
+    txDoneContext = nullptr;
+}
+
+/*!
+  * @brief Move the frame in the TX slot forward without blocking.
+  * @return true when the TX slot is empty (frame sent or dropped), false while bytes are still pending.
+  
+  * @note Only as many bytes as availableForWrite() reports are written per call.
+  * @note Called from poll(), so a frame too large for the FIFO completes over several calls.
+  * @note With echo check enabled an attempt starts only once the RX bytes pending before it are read, the caller
+  *       (poll() or a blocking send) parses and dispatches them outside pumpTx(). Only what arrives after the first
+  *       byte is compared as echo.
+!*/
+bool SAAB_HPD::pumpTx() {
+    if (txLength == 0) {
+        return true;
+    }
+
+    // Verify the echo of what was written so far
+    if (txEchoVerify && !checkTxEcho()) {
+        accountTx(txClassInFlight, txOffset); // Aborted bytes still used the bus
+        txStats.collisions++;
+        syncFound = false; // The rest of the ICM frame is in the RX stream, search for sync again
+        rxActivity = micros();
+        if (++txAttempts > echoMaxRetries) {
+            if (printDebug) Serial.println("\nCollision on every attempt, dropping frame");
+            txLength = 0;
+            if (txExpectsAck) {
+                pushEvent(EVENT_COLLISION, txBuffer[1]);
+                if (txDone) txDone(txDoneContext, ERROR_COLLISION);
+            }
+            return true;
+        }
+        if (printDebug) Serial.println("\nCollision detected, requeueing frame");
+        txOffset = 0;
+        txEchoOffset = 0;
+        txPaced = false;
+    }
+
+    // The pacer is charged once per attempt, before the first byte
+    if (!txPaced) {
+        if (!takeTxTokens(txLength)) {
+            return false;
+        }
+        txPaced = true;
+    }
+
+    // Bytes received before our first byte belong to ICM/SID frames, not to the echo. They are dispatched
+    // by the caller, a frame callback may send and must not re-enter the slot being written
+    if (txEchoVerify && txOffset == 0 && SIDSerial.available()) {
+        return false;
+    }
+
+    // After a collision the other frame is still on the wire, retry once the line has gone quiet
+    if (txEchoVerify && txOffset == 0 && txAttempts > 0 && micros() - rxActivity < SID_LINE_IDLE_MICROS) {
+        return false;
+    }
+
+    if (txOffset < txLength) {
+        size_t chunk = txLength - txOffset;
+        int room = SIDSerial.availableForWrite();
+        if (room < 0) room = 0;
+        if (chunk > (size_t)room) chunk = room;
+        if (txEchoVerify) {
+            // Keep the unverified bytes to a few byte times
+            size_t window = SID_ECHO_WINDOW - (txOffset - txEchoOffset);
+            if (chunk > window) chunk = window;
+        }
+        if (chunk > 0) {
+            SIDSerial.write(&txBuffer[txOffset], chunk);
+            txOffset += chunk;
+            txEchoActivity = micros();
+        }
+    }
+
+    if (txOffset == txLength && (!txEchoVerify || txEchoOffset == txLength)) {
+        accountTx(txClassInFlight, txLength);
+        if (journal) {
+            journal->record(SAAB_HPD_Journal::DIRECTION_TX, txBuffer, txLength);
+        }
+        if (pcapng) {
+            pcapng->writeWire(SAAB_HPD_Pcapng::DIRECTION_TX, txBuffer, txLength);
+        }
+        if (heatmap && txLength >= 2) {
+            recordHeatmap(true, txBuffer[1], &txBuffer[3], txLength > 4 ? txLength - 4 : 0, txLength);
+        }
+        txLength = 0;
+        if (txExpectsAck) {
+            expectAnswer(txBuffer[1]); // The answer is picked up by poll()
+        }
+        return true;
+    }
+    return false;
+}
+
+// RX bytes are the echo of our frame from its first byte written until it completes
+bool SAAB_HPD::rxIsEcho() {
+    return txLength != 0 && txEchoVerify && txOffset != 0;
+}
+
+bool SAAB_HPD::checkTxEcho() {
+    while (txEchoOffset < txOffset && SIDSerial.available()) {
+        uint8_t echo = SIDSerial.read();
+        if (echo != txBuffer[txEchoOffset]) {
+            if (printDebug) Serial.printf("\nEcho mismatch at byte %u: sent 0x%02X, read 0x%02X\n", (unsigned)txEchoOffset, txBuffer[txEchoOffset], echo);
+            return false;
+        }
+        txEchoOffset++;
+        txEchoActivity = micros();
+    }
+
+    if (txEchoOffset < txOffset && micros() - txEchoActivity >= echoTimeoutMicros) {
+        txStats.echoTimeouts++;
+        txEchoVerify = false; // No echo on this line, send the rest unverified
+    }
+    return true;
+}
+
+bool SAAB_HPD::takeTxTokens(size_t len) {
+    if (busShare >= 100) return true; // Pacing disabled
+
+    const float bytesPerMicro = (float)SID_BUS_BYTES_PER_SECOND * busShare / 100.0f / 1000000.0f;
+    const float capacity = BUFFER_SIZE + 2;
+    const float needed = len < capacity ? len : capacity;
+
+    unsigned long now = micros();
+    txTokens += (now - txTokensUpdated) * bytesPerMicro;
+    txTokensUpdated = now;
+    if (txTokens > capacity) txTokens = capacity;
+
+    if (txTokens < needed) {
+        if (!txThrottled) {
+            txThrottled = true;
+            txThrottleStart = now;
+        }
+        return false;
+    }
+
+    if (txThrottled) {
+        txStats.throttledFrames++;
+        txStats.throttledMicros += now - txThrottleStart;
+        txThrottled = false;
+    }
+    txTokens -= len; // Frames larger than the bucket leave it in debt
+    return true;
+}
+
+void SAAB_HPD::accountTx(TX_CLASS txClass, size_t len) {
+    if (len == 0) return;
+    if (!timers.isScheduled(txWindowTimer)) {
+        // First traffic after an idle window, the timer only runs while there is something to publish
+        txWindowStart = timers.now();
+        txWindowTimer = timers.schedule(1000, onTxWindow, this, 1000);
+    }
+    txStats.classes[txClass].frames++;
+    txStats.classes[txClass].bytes += len;
+    txWindowFrames[txClass]++;
+    txWindowBytes[txClass] += len;
+}
+
+void SAAB_HPD::onTxWindow(void* context) {
+    static_cast<SAAB_HPD*>(context)->rollTxWindow();
+}
+
+void SAAB_HPD::rollTxWindow() {
+    // Publish the finished window, a poll() gap longer than one window reads as zero
+    unsigned long now = timers.now();
+    bool idleGap = now - txWindowStart >= 2000;
+    bool idle = true;
+    for (uint8_t i = 0; i < TX_CLASS_COUNT; i++) {
+        if (txWindowFrames[i]) idle = false;
+        txStats.classes[i].framesPerSecond = idleGap ? 0 : txWindowFrames[i];
+        txStats.classes[i].bytesPerSecond = idleGap ? 0 : txWindowBytes[i];
+        txWindowFrames[i] = 0;
+        txWindowBytes[i] = 0;
+    }
+    txWindowStart = now;
+
+    // The zero rates are published, stop until accountTx() sees traffic again so poll() can report idle
+    if (idle) {
+        timers.cancel(txWindowTimer);
+        txWindowTimer = 0;
+    }
 }
 
 /*!
@@ -144,6 +555,14 @@ bool SAAB_HPD::verifyChecksum(const SerialFrame &frame) {
     return calculatedChecksum == expectedChecksum; // Return if calulated checksum matches expected checksum 
 }
 
+// Fills in DLC (from the text length when 0) and checksum
+void SAAB_HPD::completeFrame(SerialFrame &frame) {
+    if (frame.dlc == 0) {
+        frame.dlc = 2 + strlen(reinterpret_cast<const char*>(frame.data)); // Command + padding + data length
+    }
+    frame.checksum = calculateChecksum(frame);
+}
+
 uint8_t SAAB_HPD::calculateChecksum(const SerialFrame &frame) {
     uint16_t sum = frame.dlc; // Start with the DLC byte
     sum += frame.command; // Add the command byte
@@ -179,73 +598,121 @@ bool SAAB_HPD::isValidDLC(uint8_t dlc) {
   * @note The frame is copied to the provided buffer and the buffer index is reset for the next frame.
 !*/
 bool SAAB_HPD::readSIDserialData(SerialFrame &frame) {
-    static uint8_t syncIndex = 0;
-
     while (SIDSerial.available()) {
-        uint8_t byteReceived = SIDSerial.read();
-
-        if (!syncFound) {
-            if (byteReceived == syncPattern[syncIndex]) {
-                syncIndex++;
-                if (syncIndex == syncPatternLength) {
-                    if (printDebug) Serial.println("\nSync pattern detected! (0x81)");
-                    syncFound = true;
-                    bufferIndex = 0; // Reset buffer for new frame
-                    syncIndex = 0;
-                }
-            } else {
-                syncIndex = 0; // Reset sync search if mismatch
-            }
-            continue;
-        }
-
-        // If sync is found, process the incoming frame
-        if (bufferIndex == 0) {
-            // First byte is DLC (excluding itself and checksum)
-            if (isValidDLC(byteReceived)) {
-                frame.dlc = byteReceived; // Store DLC in the frame struct
-                buffer[bufferIndex++] = byteReceived;
-                expectedLength = frame.dlc + 2; // DLC + 2 (itself + checksum)
-                memset(frame.data, 0, sizeof(frame.data)); // Clear residual data
-                if (printDebug) {
-                    Serial.printf("Expected total frame length: %02X\n", expectedLength);
-                }
-            } else {
-                if (printDebug) Serial.println("\nInvalid DLC, resetting sync");
-                syncFound = false; // Reset sync if DLC is invalid
-                continue;
+        rxActivity = micros();
+        if (parseByte(SIDSerial.read(), frame)) {
+            return true; // Valid frame received
+        }
+    }
+
+    return false; // No valid frame received
+}
+
+/*!
+  * @brief Feed a single byte to the frame parser.
+  * @param byteReceived 
+      The byte read from the SID line.
+  * @param frame 
+      The frame struct filled in once a complete frame has been received.
+  * @return true if the byte completed a valid frame, false otherwise.
+  
+  * @note The parser state (sync, buffer index) is kept per instance, so several parsers can run side by side.
+!*/
+bool SAAB_HPD::parseByte(uint8_t byteReceived, SerialFrame &frame) {
+    if (forensicCapture) {
+        recordRawByte(byteReceived);
+    }
+
+    if (!syncFound) {
+        if (byteReceived == syncPatternData[syncIndex]) {
+            syncIndex++;
+            if (syncIndex == syncPatternSize) {
+                if (printDebug) Serial.printf("\nSync pattern detected! (0x%02X)\n", syncPatternData[1]);
+                syncFound = true;
+                bufferIndex = 0; // Reset buffer for new frame
+                syncIndex = 0;
             }
         } else {
+            syncIndex = 0; // Reset sync search if mismatch
+        }
+        return false;
+    }
+
+    // If sync is found, process the incoming frame
+    if (bufferIndex == 0) {
+        // First byte is DLC (excluding itself and checksum)
+        if (isValidDLC(byteReceived)) {
+            frame.dlc = byteReceived; // Store DLC in the frame struct
             buffer[bufferIndex++] = byteReceived;
+            expectedLength = frame.dlc + 2; // DLC + 2 (itself + checksum)
+            memset(frame.data, 0, sizeof(frame.data)); // Clear residual data
+            if (printDebug) {
+                Serial.printf("Expected total frame length: %02X\n", expectedLength);
+            }
+        } else {
+            if (printDebug) Serial.println("\nInvalid DLC, resetting sync");
+            if (forensicCapture) {
+                frame.dlc = byteReceived;
+                frame.command = 0x00;
+                captureParseFailure(PARSE_FAILURE_INVALID_DLC, bufferIndex, frame);
+            }
+            syncFound = false; // Reset sync if DLC is invalid
+            pushEvent(EVENT_SYNC_LOST);
+        }
+        return false;
+    }
 
-            // If the full frame is received
-            if (bufferIndex == expectedLength) {
-                // Populate the frame struct
-                frame.command = buffer[1]; // Command byte
-                if (frame.dlc > 2) { // Only copy data if DLC > 2 (command + checksum)
-                    memcpy(frame.data, &buffer[3], frame.dlc - 2); // Copy data bytes
-                }
-                frame.checksum = buffer[frame.dlc + 1]; // Checksum byte
-
-                // Verify checksum
-                if (!verifyChecksum(frame)) {
-                    if (printDebug) Serial.println("\nChecksum mismatch, resetting sync");
-                    bufferIndex = 0; // Reset buffer for next frame
-                    syncFound = false; // Reset sync if checksum is invalid
-                    continue;
-                }
+    buffer[bufferIndex++] = byteReceived;
 
-                bufferIndex = 0; // Reset buffer for next frame
-                return true; // Valid frame received
+    // If the full frame is received
+    if (bufferIndex == expectedLength) {
+        // Populate the frame struct
+        frame.command = buffer[1]; // Command byte
+        if (frame.dlc > 2) { // Only copy data if DLC > 2 (command + checksum)
+            memcpy(frame.data, &buffer[3], frame.dlc - 2); // Copy data bytes
+        }
+        frame.checksum = buffer[frame.dlc + 1]; // Checksum byte
+        bufferIndex = 0; // Reset buffer for next frame
+
+        // Verify checksum
+        if (!verifyChecksum(frame)) {
+            if (printDebug) Serial.println("\nChecksum mismatch, resetting sync");
+            if (forensicCapture) {
+                captureParseFailure(PARSE_FAILURE_CHECKSUM, expectedLength - 1, frame);
             }
+            syncFound = false; // Reset sync if checksum is invalid
+            pushEvent(EVENT_SYNC_LOST, frame.command);
+            return false;
         }
+
+        return true; // Valid frame received
     }
 
-    return false; // No valid frame received
+    return false;
 }
 
-SAAB_HPD::ERROR SAAB_HPD::makeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, char* text) {
-    SerialFrame frame;
+/*!
+  * @brief Set the pattern the parser syncs on.
+  * @param pattern 
+      The bytes of a complete frame that is known to appear on the line, must stay valid.
+  * @param length 
+      Number of bytes in the pattern.
+  * @return void
+  
+  * @note The default syncPattern (0x81 query) only appears on the ICM -> SID line, use ackPattern on the SID -> ICM line.
+!*/
+void SAAB_HPD::setSyncPattern(const uint8_t* pattern, uint8_t length) {
+    syncPatternData = pattern;
+    syncPatternSize = length;
+    syncIndex = 0;
+    syncFound = false;
+}
+
+bool SAAB_HPD::isSynced() {
+    return syncFound;
+}
+
+void SAAB_HPD::buildMakeRegion(SerialFrame &frame, uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, const char* text) {
     frame.command = 0x10; // COMMAND
     frame.dlc = 13; // Base DLC
 
@@ -275,11 +742,9 @@ SAAB_HPD::ERROR SAAB_HPD::makeRegion(uint8_t regionID, uint8_t subRegionID0, uin
     }
 
     frame.checksum = calculateChecksum(frame);
-    return sendSidData(frame);
 }
 
-SAAB_HPD::ERROR SAAB_HPD::changeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, char* text) {
-    SerialFrame frame;
+void SAAB_HPD::buildChangeRegion(SerialFrame &frame, uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text) {
     frame.command = 0x11; // COMMAND
     frame.dlc = 8; // Base DLC
 
@@ -289,7 +754,6 @@ SAAB_HPD::ERROR SAAB_HPD::changeRegion(uint8_t regionID, uint8_t subRegionID0, u
     frame.data[3] = subRegionID1;
     frame.data[4] = visible; // 0x02, 0x08 show, 0x03 (0x01?) hide
     frame.data[5] = style;
-    
 
     // Copy text to frame data if provided
     int i = 0;
@@ -302,11 +766,9 @@ SAAB_HPD::ERROR SAAB_HPD::changeRegion(uint8_t regionID, uint8_t subRegionID0, u
     }
 
     frame.checksum = calculateChecksum(frame);
-    return sendSidData(frame);
 }
 
-SAAB_HPD::ERROR SAAB_HPD::drawRegion(uint8_t regionID, uint8_t drawFlag) {
-    SerialFrame frame;
+void SAAB_HPD::buildDrawRegion(SerialFrame &frame, uint8_t regionID, uint8_t drawFlag) {
     frame.command = 0x70; // COMMAND
     frame.dlc = 5; // DLC for drawRegion
 
@@ -315,11 +777,9 @@ SAAB_HPD::ERROR SAAB_HPD::drawRegion(uint8_t regionID, uint8_t drawFlag) {
     frame.data[2] = drawFlag; // 0x01 to draw, 0x00 to hide
 
     frame.checksum = calculateChecksum(frame);
-    return sendSidData(frame);
 }
 
-SAAB_HPD::ERROR SAAB_HPD::clearRegion(uint8_t regionID, uint8_t clearFlag) {
-    SerialFrame frame;
+void SAAB_HPD::buildClearRegion(SerialFrame &frame, uint8_t regionID, uint8_t clearFlag) {
     frame.command = 0x60; // COMMAND
     frame.dlc = 5; // DLC for clearRegion
 
@@ -328,75 +788,163 @@ SAAB_HPD::ERROR SAAB_HPD::clearRegion(uint8_t regionID, uint8_t clearFlag) {
     frame.data[2] = clearFlag; // 0x01?
 
     frame.checksum = calculateChecksum(frame);
-    return sendSidData(frame);
 }
 
+/*!
+  * @brief Write a frame as it goes on the wire.
+  * @param frame 
+      The frame with DLC and checksum already set.
+  * @param out 
+      Destination buffer, must hold at least DLC + 2 bytes.
+  * @return The number of bytes written.
+  
+  * @note The padding byte after the command is emitted as 0x00.
+!*/
+size_t SAAB_HPD::serializeFrame(const SerialFrame &frame, uint8_t* out) {
+    size_t len = 0;
+    out[len++] = frame.dlc;
+    out[len++] = frame.command;
+    if (frame.dlc >= 2) {
+        out[len++] = 0x00; // Padding byte
+    }
+    for (int i = 0; i < frame.dlc - 2; i++) {
+        out[len++] = frame.data[i];
+    }
+    out[len++] = frame.checksum;
+    return len;
+}
+
+/*!
+  * @brief Copy the text of a sub-region update (0x11) out of a frame.
+  * @param frame 
+      Received 0x11 frame.
+  * @param out 
+      Destination, always NUL terminated.
+  * @param size 
+      Size of out.
+  * @return The length of the text.
+  
+  * @note Trailing spaces are dropped, the ICM pads texts with them to clear what was shown before.
+!*/
+size_t SAAB_HPD::regionText(const SerialFrame &frame, char* out, size_t size) {
+    size_t len = frame.dlc > 8 ? frame.dlc - 8 : 0;
+    if (len >= size) len = size - 1;
+    memcpy(out, &frame.data[6], len);
+    while (len > 0 && out[len - 1] == ' ') len--;
+    out[len] = '\0';
+    return len;
+}
+
+SAAB_HPD::ERROR SAAB_HPD::makeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, char* text) {
+    SerialFrame frame;
+    buildMakeRegion(frame, regionID, subRegionID0, subRegionID1, xPos, yPos, width, fontStyle, text);
+    return sendPreparedSidData(frame); // Encoder already set DLC and checksum
+}
+
+SAAB_HPD::ERROR SAAB_HPD::changeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, char* text) {
+    SerialFrame frame;
+    buildChangeRegion(frame, regionID, subRegionID0, subRegionID1, visible, style, text);
+    return sendPreparedSidData(frame);
+}
+
+SAAB_HPD::ERROR SAAB_HPD::drawRegion(uint8_t regionID, uint8_t drawFlag) {
+    SerialFrame frame;
+    buildDrawRegion(frame, regionID, drawFlag);
+    return sendPreparedSidData(frame);
+}
+
+SAAB_HPD::ERROR SAAB_HPD::clearRegion(uint8_t regionID, uint8_t clearFlag) {
+    SerialFrame frame;
+    buildClearRegion(frame, regionID, clearFlag);
+    return sendPreparedSidData(frame);
+}
+
+// AUX screen as the ICM builds it
+const SAAB_HPD::RegionDescriptor SAAB_HPD::auxLayout[] = {
+    {0x01, 0x00, 0x3C, 187, 34, 8, HPD_FONT_LARGE, nullptr},
+    {0x01, 0x00, 0x3D, 252, 31, 20, HPD_FONT_LARGE, nullptr},
+    {0x01, 0x00, 0x3E, 207, 31, 44, HPD_FONT_LARGE, nullptr},
+    {0x01, 0x02, 0xBF, 230, 54, 8, HPD_FONT_SMALL, "1"},
+    {0x01, 0x02, 0xC0, 238, 54, 8, HPD_FONT_SMALL, "2"},
+    {0x01, 0x02, 0xC1, 246, 54, 8, HPD_FONT_SMALL, "3"},
+    {0x01, 0x02, 0xC2, 254, 54, 8, HPD_FONT_SMALL, "4"},
+    {0x01, 0x02, 0xC3, 262, 54, 8, HPD_FONT_SMALL, "5"},
+    {0x01, 0x02, 0xC4, 270, 54, 8, HPD_FONT_SMALL, "6"},
+    {0x01, 0x02, 0xCD, 142, 34, 30, HPD_FONT_LARGE, "BT"},
+    {0x01, 0x02, 0xCF, 142, 34, 30, HPD_FONT_LARGE, "CD"},
+    {0x01, 0x02, 0xD0, 142, 34, 30, HPD_FONT_LARGE, "CDC"},
+    {0x01, 0x02, 0xD2, 142, 34, 30, HPD_FONT_LARGE, "CDX"},
+    {0x01, 0x02, 0xD5, 142, 34, 40, HPD_FONT_LARGE, "SCAN"},
+    {0x01, 0x02, 0xD7, 187, 34, 230, HPD_FONT_LARGE, "Checking magazine"},
+    {0x01, 0x02, 0xD9, 187, 34, 230, HPD_FONT_LARGE, "No magazine"},
+    {0x01, 0x02, 0xDB, 187, 34, 230, HPD_FONT_LARGE, "Press 1-6 to select CD"},
+    {0x01, 0x02, 0xDD, 207, 31, 61, HPD_FONT_MEDIUM, "No CD"},
+    {0x01, 0x02, 0xDF, 187, 31, 230, HPD_FONT_MEDIUM, "Play"},
+    {0x01, 0x02, 0xE6, 142, 54, 13, HPD_FONT_SMALL, "NO"},
+    {0x01, 0x02, 0xEA, 170, 54, 19, HPD_FONT_SMALL, "PTY"},
+    {0x01, 0x02, 0xEB, 192, 54, 19, HPD_FONT_SMALL, "RDM"},
+    {0x01, 0x02, 0xED, 154, 54, 13, HPD_FONT_SMALL, "TP"}
+};
+const size_t SAAB_HPD::auxLayoutCount = sizeof(auxLayout) / sizeof(auxLayout[0]);
+
+// Blocking like recreateRegion, SAAB_HPD_RegionBuilder with auxLayout does the same from poll()
 bool SAAB_HPD::recreateAuxRegion() {
+    return recreateRegion(0x01, auxLayout, auxLayoutCount);
+}
+
+/*!
+  * @brief Rebuild one region from a layout table.
+  * @param regionID 
+      Region to rebuild, descriptors of other regions are skipped.
+  * @param layout 
+      Descriptor table, e.g. auxLayout or a table loaded by SAAB_HPD_Scene.
+  * @param count 
+      Number of descriptors in the table.
+  * @return true if the region was cleared, every sub-region created and the region drawn.
+  
+  * @note Every step is retried up to 10 times, 100 ms apart.
+  * @note Blocks with delay() between the retries, up to several seconds. Meant for setup code,
+  *       from poll() (timers, events, frame callbacks) use SAAB_HPD_RegionBuilder, which retries on the timer wheel.
+!*/
+bool SAAB_HPD::recreateRegion(uint8_t regionID, const RegionDescriptor* layout, size_t count) {
     const int maxRetries = 10; // Maximum number of retries for each operation
     int retryCount = 0;
 
     // Retry clearing the region
     while (retryCount < maxRetries) {
-        if (clearRegion(0x01, 0x00) == ERROR_OK) {
-            Serial.println("Cleared AUX region successfully!");
+        if (clearRegion(regionID, 0x00) == ERROR_OK) {
+            Serial.printf("Cleared region 0x%02X successfully!\n", regionID);
             break;
         } else {
-            Serial.println("Error: Failed to clear region 0x01. Retrying...");
+            Serial.printf("Error: Failed to clear region 0x%02X. Retrying...\n", regionID);
             retryCount++;
             delay(100); // Wait before retrying
         }
     }
 
     if (retryCount >= maxRetries) {
-        Serial.println("Error: Failed to clear AUX region after maximum retries.");
+        Serial.printf("Error: Failed to clear region 0x%02X after maximum retries.\n", regionID);
         return false;
     }
 
-    // Helper lambda to handle errors with retries
-    auto retryMakeRegion = [this, maxRetries](uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, char* text) {
-        int retryCount = 0;
-        while (retryCount < maxRetries) {
-            if (this->makeRegion(regionID, subRegionID0, subRegionID1, xPos, yPos, width, fontStyle, text) == ERROR_OK) {
-                return true;
-            } else {
-                retryCount++;
-                delay(100); // Wait before retrying
+    // Recreate sub-regions with retries
+    for (size_t i = 0; i < count; i++) {
+        const RegionDescriptor &d = layout[i];
+        if (d.regionID != regionID) continue;
+
+        retryCount = 0;
+        while (makeRegion(d.regionID, d.subRegionID0, d.subRegionID1, d.xPos, d.yPos, d.width, d.fontStyle, const_cast<char*>(d.text)) != ERROR_OK) {
+            if (++retryCount >= maxRetries) {
+                Serial.printf("Error: Failed to recreate region 0x%02X after retries.\n", regionID);
+                return false;
             }
+            delay(100); // Wait before retrying
         }
-        return false;
-    };
-
-    // Recreate regions with retries
-    if (!retryMakeRegion(0x01, 0x00, 0x3C, 187, 34, 8, HPD_FONT_LARGE, nullptr) ||
-        !retryMakeRegion(0x01, 0x00, 0x3D, 252, 31, 20, HPD_FONT_LARGE, nullptr) ||
-        !retryMakeRegion(0x01, 0x00, 0x3E, 207, 31, 44, HPD_FONT_LARGE, nullptr) ||
-        !retryMakeRegion(0x01, 0x02, 0xBF, 230, 54, 8, HPD_FONT_SMALL, (char*)"1") ||
-        !retryMakeRegion(0x01, 0x02, 0xC0, 238, 54, 8, HPD_FONT_SMALL, (char*)"2") ||
-        !retryMakeRegion(0x01, 0x02, 0xC1, 246, 54, 8, HPD_FONT_SMALL, (char*)"3") ||
-        !retryMakeRegion(0x01, 0x02, 0xC2, 254, 54, 8, HPD_FONT_SMALL, (char*)"4") ||
-        !retryMakeRegion(0x01, 0x02, 0xC3, 262, 54, 8, HPD_FONT_SMALL, (char*)"5") ||
-        !retryMakeRegion(0x01, 0x02, 0xC4, 270, 54, 8, HPD_FONT_SMALL, (char*)"6") ||
-        !retryMakeRegion(0x01, 0x02, 0xCD, 142, 34, 30, HPD_FONT_LARGE, (char*)"BT") ||
-        !retryMakeRegion(0x01, 0x02, 0xCF, 142, 34, 30, HPD_FONT_LARGE, (char*)"CD") ||
-        !retryMakeRegion(0x01, 0x02, 0xD0, 142, 34, 30, HPD_FONT_LARGE, (char*)"CDC") ||
-        !retryMakeRegion(0x01, 0x02, 0xD2, 142, 34, 30, HPD_FONT_LARGE, (char*)"CDX") ||
-        !retryMakeRegion(0x01, 0x02, 0xD5, 142, 34, 40, HPD_FONT_LARGE, (char*)"SCAN") ||
-        !retryMakeRegion(0x01, 0x02, 0xD7, 187, 34, 230, HPD_FONT_LARGE, (char*)"Checking magazine") ||
-        !retryMakeRegion(0x01, 0x02, 0xD9, 187, 34, 230, HPD_FONT_LARGE, (char*)"No magazine") ||
-        !retryMakeRegion(0x01, 0x02, 0xDB, 187, 34, 230, HPD_FONT_LARGE, (char*)"Press 1-6 to select CD") ||
-        !retryMakeRegion(0x01, 0x02, 0xDD, 207, 31, 61, HPD_FONT_MEDIUM, (char*)"No CD") ||
-        !retryMakeRegion(0x01, 0x02, 0xDF, 187, 31, 230, HPD_FONT_MEDIUM, (char*)"Play") ||
-        !retryMakeRegion(0x01, 0x02, 0xE6, 142, 54, 13, HPD_FONT_SMALL, (char*)"NO") ||
-        !retryMakeRegion(0x01, 0x02, 0xEA, 170, 54, 19, HPD_FONT_SMALL, (char*)"PTY") ||
-        !retryMakeRegion(0x01, 0x02, 0xEB, 192, 54, 19, HPD_FONT_SMALL, (char*)"RDM") ||
-        !retryMakeRegion(0x01, 0x02, 0xED, 154, 54, 13, HPD_FONT_SMALL, (char*)"TP")) {
-        Serial.println("Error: Failed to recreate AUX regions after retries.");
-        return false;
     }
 
     // Draw the region
-    if (drawRegion(0x01, 0x01) != ERROR_OK) {
-        Serial.println("Error: Failed to draw region 0x01.");
+    if (drawRegion(regionID, 0x01) != ERROR_OK) {
+        Serial.printf("Error: Failed to draw region 0x%02X.\n", regionID);
         return false;
     }
 
@@ -411,20 +959,101 @@ void SAAB_HPD::replaceAuxPlayText(char* text) {
     changeRegion(0x01,0x02,0xCD, HPD_VISIBLE, HPD_STYLE_NORMAL);
 }
 
-void SAAB_HPD::poll() {
+/*!
+  * @brief Send and receive pending SID data, run expired timers and deliver events.
+  * @return Milliseconds until the next timer is due, 0 while a frame is in flight, TIMER_NO_DEADLINE when nothing is scheduled.
+  
+  * @note An integration may sleep for the returned time, as long as it wakes up on received serial data.
+!*/
+unsigned long SAAB_HPD::poll() {
+    // Continue the queued frame, its echo has to be read before the parser sees the RX stream
+    pumpTx();
+    if (!rxIsEcho()) {
+        SerialFrame frame;
+        while (readSIDserialData(frame)) {
+            dispatchFrame(frame);
+        }
+    }
+
+    timers.advance();
+    deliverEvents();
+    if (journal) {
+        journal->poll(); // Dump after an error, outside the RX/TX path
+    }
+    return getTimeToNextDeadline();
+}
+
+/*!
+  * @brief Parse and process bytes that did not come from the SID serial port.
+  * @param data 
+      Pointer to the raw bytes (recorded traffic, a second tap, a replay buffer).
+  * @param len 
+      Number of bytes.
+  * @return void
+  
+  * @note Every complete frame goes through mode detection and the frame callback, like in poll().
+!*/
+void SAAB_HPD::feed(const uint8_t* data, size_t len) {
     SerialFrame frame;
-    if (readSIDserialData(frame)) {
-        // Process the frame to update the current mode
-        processMode(frame);
+    for (size_t i = 0; i < len; i++) {
+        if (parseByte(data[i], frame)) {
+            dispatchFrame(frame);
+        }
+    }
+    deliverEvents();
+}
 
-        // Invoke the callback with the processed frame, if set
-        if (frameCallback) {
-            frameCallback(frame);
+void SAAB_HPD::dispatchFrame(const SerialFrame &frame) {
+    if (journal) {
+        uint8_t wire[BUFFER_SIZE + 2];
+        journal->record(SAAB_HPD_Journal::DIRECTION_RX, wire, serializeFrame(frame, wire));
+    }
+    if (pcapng) {
+        pcapng->writeFrame(SAAB_HPD_Pcapng::DIRECTION_RX, frame);
+    }
+    if (heatmap) {
+        recordHeatmap(false, frame.command, frame.data, frame.dlc > 2 ? frame.dlc - 2 : 0, frame.dlc + 2);
+    }
+
+    currentFrameDuplicate = dedupPolicy != DEDUP_OFF && checkDuplicate(frame);
+    bool suppressed = currentFrameDuplicate && dedupPolicy == DEDUP_SUPPRESS; // Display content did not change
+
+    Event* event = suppressed ? nullptr : pushEvent(EVENT_FRAME_RECEIVED, frame.command);
+    if (event) {
+        event->regionID = frame.data[0];
+        event->subRegionID0 = frame.data[2];
+        event->subRegionID1 = frame.data[3];
+        event->duplicate = currentFrameDuplicate;
+    }
+    if (!suppressed && (frame.command == 0x10 || frame.command == 0x11)) {
+        event = pushEvent(EVENT_REGION_CHANGED, frame.command);
+        if (event) {
+            event->regionID = frame.data[0];
+            event->subRegionID0 = frame.data[2];
+            event->subRegionID1 = frame.data[3];
         }
     }
+
+    // Answer to the frame we sent
+    if (ackPending && (frame.command == 0xFF || frame.command == 0xFE)) {
+        finishAnswer(frame.command == 0xFF ? ERROR_OK : static_cast<ERROR>(frame.data[0]));
+    }
+
+    // Process the frame to update the current mode
+    processMode(frame);
+
+    // Make the frame available to every frame consumer
+    publishFrame(frame);
+
+    // Invoke the callback with the processed frame, if set
+    if (frameCallback && !suppressed) {
+        frameCallback(frame);
+    }
+    currentFrameDuplicate = false;
 }
 
 void SAAB_HPD::processMode(const SerialFrame &frame) {
+    MODE previousMode = currentMode;
     if (frame.command == 0x11) { // Check if the frame is a display update
         if (frame.data[0] == 0x01 && frame.data[2] == 0x02 && frame.data[3] == 0xCF) {
             currentMode = MODE_CD;
@@ -447,6 +1076,14 @@ void SAAB_HPD::processMode(const SerialFrame &frame) {
             }
         }
     }
+
+    if (currentMode != previousMode) {
+        Event* event = pushEvent(EVENT_MODE_CHANGED, frame.command);
+        if (event) {
+            event->mode = currentMode;
+            event->previousMode = previousMode;
+        }
+    }
 }
 
 SAAB_HPD::MODE SAAB_HPD::getMode() {
@@ -455,4 +1092,444 @@ SAAB_HPD::MODE SAAB_HPD::getMode() {
 
 void SAAB_HPD::setFrameCallback(FrameCallback callback) {
     frameCallback = callback;
-}
\ No newline at end of file
+}
+
+void SAAB_HPD::setEventCallback(EventCallback callback) {
+    eventCallback = callback;
+}
+
+const SAAB_HPD::Event* SAAB_HPD::getEvents(uint8_t &count) {
+    count = eventCount;
+    return eventQueue;
+}
+
+void SAAB_HPD::clearEvents() {
+    eventCount = 0;
+}
+
+uint32_t SAAB_HPD::getDroppedEventCount() {
+    return eventsDropped;
+}
+
+SAAB_HPD::Event* SAAB_HPD::pushEvent(EVENT_TYPE type, uint8_t command) {
+    if (journal && (type == EVENT_NACK || type == EVENT_TIMEOUT || type == EVENT_SYNC_LOST || type == EVENT_COLLISION)) {
+        journal->notifyError();
+    }
+
+    if (eventCount == EVENT_QUEUE_SIZE) {
+        eventsDropped++;
+        return nullptr;
+    }
+
+    Event &event = eventQueue[eventCount++];
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.command = command;
+    event.mode = currentMode;
+    event.previousMode = currentMode;
+    event.timestamp = timers.now();
+    return &event;
+}
+
+void SAAB_HPD::onAckTimeout(void* context) {
+    SAAB_HPD* hpd = static_cast<SAAB_HPD*>(context);
+    if (hpd->ackPending) {
+        hpd->finishAnswer(ERROR_TIMEOUT);
+    }
+}
+
+void SAAB_HPD::expectAnswer(uint8_t command) {
+    ackPending = true;
+    ackCommand = command;
+    ackDone = txDone;
+    ackDoneContext = txDoneContext;
+    ackSentAt = timers.now();
+    timers.cancel(ackTimer);
+    ackTimer = timers.schedule(SID_ACK_TIMEOUT_MS, onAckTimeout, this);
+}
+
+/*!
+  * @brief Complete the outstanding answer with its event and done callback.
+  * @param result 
+      ERROR_OK for an ACK, the SID error code for a NACK, ERROR_TIMEOUT.
+  * @return void
+  
+  * @note The slot is free again before done runs, so done may queue the next frame.
+!*/
+void SAAB_HPD::finishAnswer(ERROR result) {
+    ackPending = false;
+    timers.cancel(ackTimer);
+    ackTimer = 0;
+    TxDoneCallback done = ackDone;
+    void* context = ackDoneContext;
+    ackDone = nullptr;
+    ackDoneContext = nullptr;
+
+    if (result == ERROR_OK) {
+        pushEvent(EVENT_ACK, ackCommand);
+    } else if (result == ERROR_TIMEOUT) {
+        pushEvent(EVENT_TIMEOUT, ackCommand);
+    } else {
+        Event* event = pushEvent(EVENT_NACK, ackCommand);
+        if (event) event->code = result;
+    }
+    if (done) {
+        done(context, result);
+    }
+}
+
+/*!
+  * @brief Hand all queued events to the event callback in one call.
+  * @return void
+  
+  * @note Events queued from inside the callback (e.g. by sendSidData) are kept for the next delivery.
+!*/
+void SAAB_HPD::deliverEvents() {
+    if (!eventCallback || eventCount == 0) {
+        return;
+    }
+
+    uint8_t delivered = eventCount;
+    eventCallback(eventQueue, delivered);
+
+    // Keep what was queued during the callback
+    memmove(eventQueue, &eventQueue[delivered], (eventCount - delivered) * sizeof(Event));
+    eventCount -= delivered;
+}
+
+/*!
+  * @brief Set how frames identical to the last one for the same sub-region are handled.
+  * @param policy 
+      DEDUP_OFF, DEDUP_MARK or DEDUP_SUPPRESS.
+  * @return void
+  
+  * @note Only sub-region updates (0x11, 0x30, 0x33) are compared, ACKs and region setup always go through.
+  * @note Creating (0x10) or clearing (0x60) a region forgets its cached content, so the next update is never a duplicate.
+!*/
+void SAAB_HPD::setDedupPolicy(DEDUP_POLICY policy) {
+    dedupPolicy = policy;
+    resetDedup();
+}
+
+bool SAAB_HPD::isDuplicateFrame() {
+    return currentFrameDuplicate;
+}
+
+uint32_t SAAB_HPD::getDedupHits() {
+    return dedupHits;
+}
+
+uint32_t SAAB_HPD::getDedupMisses() {
+    return dedupMisses;
+}
+
+void SAAB_HPD::resetDedup() {
+    memset(dedupCache, 0, sizeof(dedupCache));
+    dedupHits = 0;
+    dedupMisses = 0;
+}
+
+bool SAAB_HPD::checkDuplicate(const SerialFrame &frame) {
+    if (frame.command == 0x10) {
+        invalidateDedup(frame.data[0], (frame.data[2] << 8) | frame.data[3]);
+        return false;
+    }
+    if (frame.command == 0x60) {
+        invalidateDedup(frame.data[0]);
+        return false;
+    }
+    if (frame.command != 0x11 && frame.command != 0x30 && frame.command != 0x33) {
+        return false;
+    }
+
+    // Key is never 0, the command byte is always set in the top bits
+    uint32_t key = ((uint32_t)frame.command << 24) | ((uint32_t)frame.data[0] << 16) | (frame.data[2] << 8) | frame.data[3];
+
+    // FNV-1a over DLC and data
+    uint32_t hash = 2166136261UL;
+    hash = (hash ^ frame.dlc) * 16777619UL;
+    for (int i = 0; i < frame.dlc - 2; i++) {
+        hash = (hash ^ frame.data[i]) * 16777619UL;
+    }
+    if (hash == 0) hash = 1; // 0 marks an invalidated entry
+
+    // Linear probe from the home slot, a full table overwrites the home slot
+    uint16_t home = (uint32_t)(key * 2654435761UL) >> (32 - DEDUP_CACHE_BITS); // Fibonacci hashing
+    uint16_t slot = home;
+    for (uint16_t probe = 0; probe < DEDUP_CACHE_SIZE; probe++) {
+        DedupEntry &entry = dedupCache[slot];
+        if (entry.key == key) {
+            if (entry.hash == hash) {
+                dedupHits++;
+                return true;
+            }
+            entry.hash = hash;
+            dedupMisses++;
+            return false;
+        }
+        if (entry.key == 0) {
+            break;
+        }
+        slot = (slot + 1) % DEDUP_CACHE_SIZE;
+    }
+
+    DedupEntry &entry = dedupCache[dedupCache[slot].key == 0 ? slot : home];
+    entry.key = key;
+    entry.hash = hash;
+    dedupMisses++;
+    return false;
+}
+
+void SAAB_HPD::invalidateDedup(uint8_t regionID, int32_t subRegion) {
+    // Empty slots would break probe chains, so invalidated entries keep their key with hash 0
+    for (uint16_t i = 0; i < DEDUP_CACHE_SIZE; i++) {
+        DedupEntry &entry = dedupCache[i];
+        if (entry.key == 0 || ((entry.key >> 16) & 0xFF) != regionID) continue;
+        if (subRegion >= 0 && (int32_t)(entry.key & 0xFFFF) != subRegion) continue;
+        entry.hash = 0;
+    }
+}
+
+/*!
+  * @brief Register a frame consumer on the received frame ring.
+  * @return The consumer id, -1 if FRAME_RING_MAX_CONSUMERS are registered or the ring could not be allocated.
+  
+  * @note The ring (FRAME_RING_SIZE frames) is allocated on the first call, a new consumer starts at the next frame.
+!*/
+int8_t SAAB_HPD::addFrameConsumer() {
+    if (frameRing == nullptr) {
+        frameRing = static_cast<SerialFrame*>(malloc(FRAME_RING_SIZE * sizeof(SerialFrame)));
+        if (frameRing == nullptr) {
+            return -1;
+        }
+    }
+
+    for (int8_t i = 0; i < FRAME_RING_MAX_CONSUMERS; i++) {
+        if (!frameConsumers[i].active) {
+            frameConsumers[i].active = true;
+            frameConsumers[i].cursor = frameRingHead;
+            frameConsumers[i].maxLag = 0;
+            frameConsumers[i].dropped = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SAAB_HPD::removeFrameConsumer(int8_t consumer) {
+    if (consumer >= 0 && consumer < FRAME_RING_MAX_CONSUMERS) {
+        frameConsumers[consumer].active = false;
+    }
+}
+
+/*!
+  * @brief Read the next frame for a consumer.
+  * @param consumer 
+      Id returned by addFrameConsumer().
+  * @return Pointer into the ring, nullptr when there is no unread frame.
+  
+  * @note The frame is not copied. The pointer is only safe until the next frame is received (poll(), feed() or a
+  *       send that reads the line), a consumer that was FRAME_RING_SIZE frames behind gets the slot written next.
+  *       Copy the frame to keep it longer.
+  * @note A consumer that falls more than FRAME_RING_SIZE frames behind skips to the oldest frame still held, the skipped frames are counted as dropped.
+!*/
+const SAAB_HPD::SerialFrame* SAAB_HPD::nextFrame(int8_t consumer) {
+    if (consumer < 0 || consumer >= FRAME_RING_MAX_CONSUMERS || !frameConsumers[consumer].active) {
+        return nullptr;
+    }
+
+    FrameConsumer &c = frameConsumers[consumer];
+    uint32_t lag = frameRingHead - c.cursor;
+    if (lag == 0) {
+        return nullptr;
+    }
+    if (lag > FRAME_RING_SIZE) {
+        c.dropped += lag - FRAME_RING_SIZE;
+        c.cursor = frameRingHead - FRAME_RING_SIZE;
+    }
+    return &frameRing[c.cursor++ & (FRAME_RING_SIZE - 1)];
+}
+
+uint32_t SAAB_HPD::getConsumerLag(int8_t consumer) {
+    if (consumer < 0 || consumer >= FRAME_RING_MAX_CONSUMERS) return 0;
+    return frameRingHead - frameConsumers[consumer].cursor;
+}
+
+uint32_t SAAB_HPD::getConsumerMaxLag(int8_t consumer) {
+    if (consumer < 0 || consumer >= FRAME_RING_MAX_CONSUMERS) return 0;
+    return frameConsumers[consumer].maxLag;
+}
+
+uint32_t SAAB_HPD::getConsumerDropped(int8_t consumer) {
+    if (consumer < 0 || consumer >= FRAME_RING_MAX_CONSUMERS) return 0;
+    return frameConsumers[consumer].dropped;
+}
+
+void SAAB_HPD::publishFrame(const SerialFrame &frame) {
+    if (frameRing == nullptr) {
+        return;
+    }
+
+    // One copy into the ring shared by all consumers, the producer never waits for them
+    frameRing[frameRingHead & (FRAME_RING_SIZE - 1)] = frame;
+    frameRingHead++;
+
+    for (uint8_t i = 0; i < FRAME_RING_MAX_CONSUMERS; i++) {
+        FrameConsumer &c = frameConsumers[i];
+        if (!c.active) continue;
+        uint32_t lag = frameRingHead - c.cursor;
+        if (lag > c.maxLag) c.maxLag = lag;
+    }
+}
+
+/*!
+  * @brief Attach a frame journal.
+  * @param journal 
+      Journal that records every received and sent frame, nullptr to detach.
+  * @return void
+  
+  * @note The journal is told about NACKs, ACK timeouts and sync loss so it can dump itself from the next poll().
+!*/
+void SAAB_HPD::setJournal(SAAB_HPD_Journal* journal) {
+    this->journal = journal;
+}
+
+/*!
+  * @brief Keep the raw bytes around parser failures.
+  * @param enable 
+      true to record the last FORENSIC_BEFORE_BYTES received bytes and snapshot them on an invalid DLC or checksum mismatch.
+  * @return void
+  
+  * @note Each record also takes the FORENSIC_AFTER_BYTES bytes that follow the failure, to tell line noise apart from frame formats the parser does not know.
+!*/
+void SAAB_HPD::setForensicCapture(bool enable) {
+    forensicCapture = enable;
+    rawHistoryPos = 0;
+    rawHistoryFill = 0;
+    collectingAfter = nullptr;
+}
+
+uint8_t SAAB_HPD::getParseFailureCount() {
+    return parseFailureCount;
+}
+
+const SAAB_HPD::ParseFailure* SAAB_HPD::getParseFailure(uint8_t age) {
+    if (age >= parseFailureCount) {
+        return nullptr;
+    }
+    return &parseFailures[(parseFailureHead + FORENSIC_RECORDS - 1 - age) % FORENSIC_RECORDS];
+}
+
+uint32_t SAAB_HPD::getTotalParseFailures() {
+    return parseFailureTotal;
+}
+
+void SAAB_HPD::printParseFailures(Print &out) {
+    out.printf("\n--- Parse failures (%u held, %u total) ---\n", parseFailureCount, (unsigned)parseFailureTotal);
+    for (uint8_t age = parseFailureCount; age > 0; age--) {
+        const ParseFailure* f = getParseFailure(age - 1);
+        out.printf("%10lu %s: index %u, expected length %u, DLC 0x%02X, COMMAND 0x%02X",
+                   f->timestamp, f->reason == PARSE_FAILURE_CHECKSUM ? "CHECKSUM" : "INVALID DLC",
+                   f->bufferIndex, f->expectedLength, f->dlc, f->command);
+        if (f->reason == PARSE_FAILURE_CHECKSUM) {
+            out.printf(", checksum 0x%02X != 0x%02X", f->receivedChecksum, f->calculatedChecksum);
+        }
+        out.print("\n  before:");
+        for (uint8_t i = 0; i < f->beforeLength; i++) out.printf(" %02X", f->before[i]);
+        out.print("\n  after: ");
+        for (uint8_t i = 0; i < f->afterLength; i++) out.printf(" %02X", f->after[i]);
+        out.println();
+    }
+    out.println("------------------------------------");
+}
+
+void SAAB_HPD::recordRawByte(uint8_t byteReceived) {
+    rawHistory[rawHistoryPos] = byteReceived;
+    rawHistoryPos = (rawHistoryPos + 1) % FORENSIC_BEFORE_BYTES;
+    if (rawHistoryFill < FORENSIC_BEFORE_BYTES) rawHistoryFill++;
+
+    if (collectingAfter) {
+        collectingAfter->after[collectingAfter->afterLength++] = byteReceived;
+        if (collectingAfter->afterLength == FORENSIC_AFTER_BYTES) {
+            collectingAfter = nullptr;
+        }
+    }
+}
+
+void SAAB_HPD::captureParseFailure(PARSE_FAILURE reason, uint8_t stateIndex, const SerialFrame &frame) {
+    ParseFailure &f = parseFailures[parseFailureHead];
+    parseFailureHead = (parseFailureHead + 1) % FORENSIC_RECORDS;
+    if (parseFailureCount < FORENSIC_RECORDS) parseFailureCount++;
+    parseFailureTotal++;
+
+    f.timestamp = micros();
+    f.reason = reason;
+    f.bufferIndex = stateIndex;
+    f.expectedLength = expectedLength;
+    f.dlc = frame.dlc;
+    f.command = frame.command;
+    f.receivedChecksum = reason == PARSE_FAILURE_CHECKSUM ? frame.checksum : 0x00;
+    f.calculatedChecksum = reason == PARSE_FAILURE_CHECKSUM ? calculateChecksum(frame) : 0x00;
+
+    // Oldest history byte first
+    f.beforeLength = rawHistoryFill;
+    uint8_t start = (rawHistoryPos + FORENSIC_BEFORE_BYTES - rawHistoryFill) % FORENSIC_BEFORE_BYTES;
+    for (uint8_t i = 0; i < rawHistoryFill; i++) {
+        f.before[i] = rawHistory[(start + i) % FORENSIC_BEFORE_BYTES];
+    }
+    f.afterLength = 0;
+    collectingAfter = &f; // A pending record stops collecting when a newer failure arrives
+}
+
+/*!
+  * @brief Attach a traffic heatmap.
+  * @param heatmap 
+      Heatmap that counts every received and sent frame per sub-region, nullptr to detach.
+  * @return void
+!*/
+void SAAB_HPD::setHeatmap(SAAB_HPD_Heatmap* heatmap) {
+    this->heatmap = heatmap;
+}
+
+void SAAB_HPD::recordHeatmap(bool tx, uint8_t command, const uint8_t* data, size_t dataLength, uint16_t bytes) {
+    // Region frames carry the region in [0] and the sub-region in [2:3]
+    bool region = command == 0x10 || command == 0x11 || command == 0x30 || command == 0x33 || command == 0x60 || command == 0x70;
+    bool subRegion = region && command != 0x60 && command != 0x70 && dataLength >= 4;
+    heatmap->record(tx ? SAAB_HPD_Heatmap::DIRECTION_TX : SAAB_HPD_Heatmap::DIRECTION_RX, command,
+                    region && dataLength >= 1 ? data[0] : 0x00,
+                    subRegion ? (data[2] << 8) | data[3] : 0x0000, bytes);
+}
+
+/*!
+  * @brief Attach a pcapng writer.
+  * @param pcapng 
+      Writer that gets every received and sent frame, nullptr to detach.
+  * @return void
+!*/
+void SAAB_HPD::setPcapng(SAAB_HPD_Pcapng* pcapng) {
+    this->pcapng = pcapng;
+}
+
+/*!
+  * @brief Replace the time source used by timers, ACK timeouts and event timestamps.
+  * @param clock 
+      Function returning monotonic milliseconds, e.g. a simulated clock on the host.
+  * @return void
+  
+  * @note TX pacing and echo timing stay on micros(), they work below the 1 ms timer resolution.
+!*/
+void SAAB_HPD::setClock(SAAB_HPD_Timer::ClockSource clock) {
+    timers.setClock(clock);
+    txWindowStart = timers.now();
+}
+
+SAAB_HPD_Timer& SAAB_HPD::getTimers() {
+    return timers;
+}
+
+unsigned long SAAB_HPD::getTimeToNextDeadline() {
+    if (txLength != 0) {
+        return 0; // pumpTx() has work to do
+    }
+    return timers.nextDeadline();
+}
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <SAAB_HPD_Timer.h>
 
 // Namespace for constants
 namespace SAAB_HPD_Constants {
@@ -31,10 +32,47 @@ using namespace SAAB_HPD_Constants; // Use the constants namespace
 // Buffer size for incoming data
 #define BUFFER_SIZE 0xFF
 
+// SID line speed, 8N1 so 10 bits on the wire per byte
+#define SID_BAUD_RATE 115200
+#define SID_BUS_BYTES_PER_SECOND (SID_BAUD_RATE / 10)
+
+// Bytes written ahead of the verified echo when echo check is enabled
+#define SID_ECHO_WINDOW 4
+
+// RX quiet time before a collided frame is sent again, two byte times
+#define SID_LINE_IDLE_MICROS (2 * 10 * 1000000UL / SID_BAUD_RATE)
+
+// Time the SID has to answer a frame
+#define SID_ACK_TIMEOUT_MS 100
+
+// Events queued between two deliveries, further events are dropped and counted
+#define EVENT_QUEUE_SIZE 32
+
+// Sub-regions whose last frame content is remembered for duplicate detection
+#define DEDUP_CACHE_BITS 6
+#define DEDUP_CACHE_SIZE (1 << DEDUP_CACHE_BITS)
+
+// Parse failures kept with the raw bytes around them
+#define FORENSIC_RECORDS 4
+#define FORENSIC_BEFORE_BYTES 48
+#define FORENSIC_AFTER_BYTES 16
+
+// Received frames kept for frame consumers, must be a power of two
+#define FRAME_RING_SIZE 16
+#define FRAME_RING_MAX_CONSUMERS 4
+
+class SAAB_HPD_Journal;
+class SAAB_HPD_Heatmap;
+class SAAB_HPD_Pcapng;
+
 // Sync pattern for SID communication
 const uint8_t syncPattern[] = {0x02, 0x81, 0x00, 0x83};
 const uint8_t syncPatternLength = sizeof(syncPattern);
 
+// OK response from the SID, used to sync a parser on the SID -> ICM line
+const uint8_t ackPattern[] = {0x02, 0xFF, 0x00, 0x01};
+const uint8_t ackPatternLength = sizeof(ackPattern);
+
 class SAAB_HPD {
 public:
     // frame struct
@@ -47,6 +85,7 @@ public:
     };
 
     SAAB_HPD(HardwareSerial &serial = Serial2);
+    ~SAAB_HPD();
 
     void begin(uint8_t rxPin, uint8_t txPin);
     void setDebug(bool enable = false);
@@ -58,6 +97,7 @@ public:
     enum ERROR {
         ERROR_OK = 0,          // Success
         ERROR_TIMEOUT = -1,    // Timeout waiting for response
+        ERROR_COLLISION = -2,  // Echo mismatch on every attempt, frame not sent
         ERROR_INVALID_COMMAND = 0x31, // Invalid command
         ERROR_REGION_EXISTS = 0x33,   // Region already exists
         ERROR_INVALID_ARGS = 0x34,    // Invalid arguments/length
@@ -65,16 +105,75 @@ public:
         ERROR_UNKNOWN_37 = 0x37       // Unknown error 0x37
     };
 
+    // Outcome of a queued frame: ERROR_OK on ACK, the SID error code on NACK, ERROR_TIMEOUT or ERROR_COLLISION
+    typedef void (*TxDoneCallback)(void* context, ERROR result);
+
     // sid communication functions
     ERROR sendSidData(SerialFrame &frame); // Returns an ERROR enum
+    bool queueSidData(SerialFrame &frame, TxDoneCallback done = nullptr, void* context = nullptr); // Non-blocking send, written out from poll(), false while the TX slot is busy
+    ERROR sendPreparedSidData(const SerialFrame &frame); // Trusts the DLC and checksum already in the frame
+    bool queuePreparedSidData(const SerialFrame &frame, TxDoneCallback done = nullptr, void* context = nullptr);
+    ERROR sendEncodedSidData(const uint8_t* bytes, size_t len); // Wire bytes of a complete frame, copied in one go
+    bool queueEncodedSidData(const uint8_t* bytes, size_t len, TxDoneCallback done = nullptr, void* context = nullptr);
+    bool isTxBusy(); // true while a queue call would fail
     void sendSidRawData(size_t len, byte* data);
     void sendTestModeMessage();
 
+    // Enum for TX command classes used in bandwidth accounting
+    enum TX_CLASS {
+        TX_CLASS_REGION_SETUP,  // 0x10
+        TX_CLASS_REGION_UPDATE, // 0x11
+        TX_CLASS_REGION_DRAW,   // 0x60, 0x70
+        TX_CLASS_RAW,           // 0x40 and sendSidRawData
+        TX_CLASS_OTHER,         // Everything else
+        TX_CLASS_COUNT
+    };
+
+    struct TxClassStats {
+        uint32_t frames;          // Frames sent since reset
+        uint32_t bytes;           // Bytes sent since reset
+        uint16_t framesPerSecond; // Frames sent in the last complete second
+        uint16_t bytesPerSecond;  // Bytes sent in the last complete second
+    };
+
+    struct TxStats {
+        TxClassStats classes[TX_CLASS_COUNT];
+        uint32_t throttledFrames; // Frames that had to wait for the pacer
+        uint32_t throttledMicros; // Total time spent waiting for the pacer
+        uint32_t collisions;      // Frames aborted on an echo mismatch
+        uint32_t echoTimeouts;    // Frames sent without a complete echo
+    };
+
+    // TX pacing, limits our share of the bus shared with the ICM
+    void setBusShare(uint8_t percent); // 1-100 % of SID_BUS_BYTES_PER_SECOND, 100 disables pacing
+    uint8_t getBusShare();
+    const TxStats& getTxStats();
+    void resetTxStats();
+    static TX_CLASS commandClass(uint8_t command);
+
+    // Echo verification, the half-duplex line reads back our own bytes so a collision with the ICM shows up as a mismatch
+    void setEchoCheck(bool enable, uint8_t maxRetries = 3, uint16_t echoTimeoutMicros = 2000);
+
     // Functions to create and modify regions on the display
     // Should return the enum error/ack code from the SID
     ERROR makeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, char* text = nullptr);
     ERROR changeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, char* text = nullptr);
-    bool recreateAuxRegion(); // Function to recreate the AUX region
+    bool recreateAuxRegion(); // Function to recreate the AUX region, blocks, see recreateRegion
+
+    // One sub-region of a screen layout, the arguments of makeRegion
+    struct RegionDescriptor {
+        uint8_t regionID;
+        uint8_t subRegionID0;
+        uint8_t subRegionID1;
+        uint16_t xPos;
+        uint8_t yPos;
+        uint8_t width;
+        uint8_t fontStyle;
+        const char* text; // nullptr for none
+    };
+    static const RegionDescriptor auxLayout[]; // Sub-regions created by recreateAuxRegion
+    static const size_t auxLayoutCount;
+    bool recreateRegion(uint8_t regionID, const RegionDescriptor* layout, size_t count); // Clears the region, creates its descriptors and draws it, blocks for setup code
     void replaceAuxPlayText(char* text); // Function to replace the "Play" region text
     ERROR drawRegion(uint8_t regionID, uint8_t drawFlag = 0x01);
     ERROR clearRegion(uint8_t regionID, uint8_t clearFlag = 0x01);
@@ -93,29 +192,253 @@ public:
 
     MODE getMode(); // Returns the current mode based on the last processed frame
 
-    void poll(); // Polls and processes incoming SID serial data
+    unsigned long poll(); // Polls and processes incoming SID serial data, returns ms until the next timer is due
+    void feed(const uint8_t* data, size_t len); // Parses and processes bytes from another source (replay, capture)
+    bool parseByte(uint8_t byteReceived, SerialFrame &frame); // Feeds one byte to the parser, true when a frame is complete
+    void setSyncPattern(const uint8_t* pattern, uint8_t length); // Pattern the parser syncs on, syncPattern by default
+    bool isSynced(); // false until the sync pattern is seen and after an invalid DLC or checksum
+
+    // Frame encoders, build a complete frame (DLC + checksum) without sending it
+    static void buildMakeRegion(SerialFrame &frame, uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t fontStyle, const char* text = nullptr);
+    static void buildChangeRegion(SerialFrame &frame, uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text = nullptr);
+    static void buildDrawRegion(SerialFrame &frame, uint8_t regionID, uint8_t drawFlag = 0x01);
+    static void buildClearRegion(SerialFrame &frame, uint8_t regionID, uint8_t clearFlag = 0x01);
+    static size_t serializeFrame(const SerialFrame &frame, uint8_t* out); // Writes the wire bytes, returns the length
+    static size_t regionText(const SerialFrame &frame, char* out, size_t size); // Text of a 0x11 frame without the padding spaces
 
     // Callback for handling processed frames
     typedef void (*FrameCallback)(const SerialFrame &frame);
     void setFrameCallback(FrameCallback callback);
 
+    // Enum for typed events
+    enum EVENT_TYPE {
+        EVENT_FRAME_RECEIVED,  // Any valid frame, command/regionID/subRegion set
+        EVENT_MODE_CHANGED,    // mode and previousMode set
+        EVENT_ACK,             // Our frame acknowledged, command set
+        EVENT_NACK,            // Our frame refused, command and code (ERROR) set
+        EVENT_TIMEOUT,         // No answer to our frame within SID_ACK_TIMEOUT_MS, command set
+        EVENT_SYNC_LOST,       // Parser dropped sync on an invalid DLC or checksum
+        EVENT_REGION_CHANGED,  // 0x10/0x11 frame, command/regionID/subRegion set
+        EVENT_COLLISION        // Our frame dropped after colliding on every attempt, command set
+    };
+
+    struct Event {
+        EVENT_TYPE type;
+        uint8_t command;
+        uint8_t code;
+        bool duplicate; // EVENT_FRAME_RECEIVED with the same content as the last frame for this sub-region
+        uint8_t regionID;
+        uint8_t subRegionID0;
+        uint8_t subRegionID1;
+        MODE mode;
+        MODE previousMode;
+        unsigned long timestamp; // Clock source ms, millis() by default
+    };
+
+    // Called once per poll() with every event queued since the last delivery
+    typedef void (*EventCallback)(const Event* events, uint8_t count);
+    void setEventCallback(EventCallback callback);
+    const Event* getEvents(uint8_t &count); // Pull access when no callback is set
+    void clearEvents();
+    uint32_t getDroppedEventCount();
+
+    // Duplicate frame handling for periodic ICM refreshes (0x11, 0x30, 0x33)
+    enum DEDUP_POLICY {
+        DEDUP_OFF,      // Every frame is processed
+        DEDUP_MARK,     // Duplicates are processed but flagged, see isDuplicateFrame()
+        DEDUP_SUPPRESS  // Duplicates skip EVENT_FRAME_RECEIVED, EVENT_REGION_CHANGED and the frame callback, mode detection and frame consumers still see them
+    };
+    void setDedupPolicy(DEDUP_POLICY policy);
+    bool isDuplicateFrame(); // True while the frame being dispatched is a duplicate
+    uint32_t getDedupHits();
+    uint32_t getDedupMisses();
+    void resetDedup();
+
+    // Multi-consumer fan-out of received frames, each consumer reads at its own pace
+    int8_t addFrameConsumer(); // Returns the consumer id, -1 if all slots are taken or out of memory
+    void removeFrameConsumer(int8_t consumer);
+    const SerialFrame* nextFrame(int8_t consumer); // nullptr when the consumer has caught up, valid until the next frame is received
+    uint32_t getConsumerLag(int8_t consumer); // Frames published but not yet read
+    uint32_t getConsumerMaxLag(int8_t consumer);
+    uint32_t getConsumerDropped(int8_t consumer); // Frames overwritten before the consumer read them
+
+    // Forensic capture of parse failures
+    enum PARSE_FAILURE {
+        PARSE_FAILURE_INVALID_DLC,
+        PARSE_FAILURE_CHECKSUM
+    };
+
+    struct ParseFailure {
+        unsigned long timestamp;            // micros() of the failing byte
+        PARSE_FAILURE reason;
+        uint8_t bufferIndex;                // Parser state when the failing byte arrived
+        uint8_t expectedLength;
+        uint8_t dlc;
+        uint8_t command;
+        uint8_t receivedChecksum;           // PARSE_FAILURE_CHECKSUM only
+        uint8_t calculatedChecksum;
+        uint8_t beforeLength;
+        uint8_t before[FORENSIC_BEFORE_BYTES]; // Raw bytes up to and including the failing byte
+        uint8_t afterLength;
+        uint8_t after[FORENSIC_AFTER_BYTES];   // Raw bytes that followed
+    };
+
+    void setForensicCapture(bool enable);
+    uint8_t getParseFailureCount(); // Records held, at most FORENSIC_RECORDS
+    const ParseFailure* getParseFailure(uint8_t age); // 0 is the newest, nullptr if not held
+    uint32_t getTotalParseFailures();
+    void printParseFailures(Print &out = Serial);
+
+    // Journal of recent RX/TX frames, nullptr to detach
+    void setJournal(SAAB_HPD_Journal* journal);
+
+    // Per sub-region traffic counters for RX and TX, nullptr to detach
+    void setHeatmap(SAAB_HPD_Heatmap* heatmap);
+
+    // pcapng capture of RX/TX frames, nullptr to detach
+    void setPcapng(SAAB_HPD_Pcapng* pcapng);
+
+    // Timers, run from poll() on the clock source
+    void setClock(SAAB_HPD_Timer::ClockSource clock); // millis() by default
+    SAAB_HPD_Timer& getTimers();
+    unsigned long getTimeToNextDeadline(); // 0 while TX is in flight, TIMER_NO_DEADLINE when idle
+
 private:
+    friend struct SAAB_HPD_BenchmarkHook; // examples/Benchmark times processMode() on its own instance
     HardwareSerial &SIDSerial;
     bool printDebug;
     uint8_t buffer[BUFFER_SIZE];
     uint8_t bufferIndex;
     uint8_t expectedLength;
     bool syncFound;
+    uint8_t syncIndex;
+    const uint8_t* syncPatternData;
+    uint8_t syncPatternSize;
 
     FrameCallback frameCallback; // Callback function for processed frames
 
+    // Event queue, flushed to eventCallback at the end of poll()
+    EventCallback eventCallback;
+    Event eventQueue[EVENT_QUEUE_SIZE];
+    uint8_t eventCount;
+    uint32_t eventsDropped;
+
+    // Duplicate detection, open addressed on (command, region, sub-region)
+    struct DedupEntry {
+        uint32_t key; // 0 when empty
+        uint32_t hash;
+    };
+    DEDUP_POLICY dedupPolicy;
+    DedupEntry dedupCache[DEDUP_CACHE_SIZE];
+    uint32_t dedupHits;
+    uint32_t dedupMisses;
+    bool currentFrameDuplicate;
+
+    // Frame ring, allocated when the first consumer is added
+    struct FrameConsumer {
+        bool active;
+        uint32_t cursor; // Sequence number of the next frame to read
+        uint32_t maxLag;
+        uint32_t dropped;
+    };
+    SerialFrame* frameRing;
+    uint32_t frameRingHead; // Sequence number of the next frame to publish
+    FrameConsumer frameConsumers[FRAME_RING_MAX_CONSUMERS];
+
+    SAAB_HPD_Journal* journal;
+    SAAB_HPD_Heatmap* heatmap;
+    SAAB_HPD_Pcapng* pcapng;
+
+    // Forensic capture
+    bool forensicCapture;
+    uint8_t rawHistory[FORENSIC_BEFORE_BYTES];
+    uint8_t rawHistoryPos;
+    uint8_t rawHistoryFill;
+    ParseFailure parseFailures[FORENSIC_RECORDS];
+    uint8_t parseFailureHead; // Next record to write
+    uint8_t parseFailureCount;
+    uint32_t parseFailureTotal;
+    ParseFailure* collectingAfter; // Record still taking post-failure bytes
+
+    SAAB_HPD_Timer timers;
+
+    // Answer tracking for the frame written last, the TX slot stays busy until it is answered or timed out
+    bool ackPending;
+    uint8_t ackCommand;
+    TxDoneCallback ackDone;
+    void* ackDoneContext;
+    unsigned long ackSentAt; // Clock time the frame was written
+    SAAB_HPD_Timer::TimerId ackTimer;
+
+    // Result of a blocking send, filled in by onSendDone
+    struct SendResult {
+        bool done;
+        ERROR result;
+    };
+
+    // Token bucket pacer and TX accounting
+    uint8_t busShare;
+    float txTokens; // Bytes that may be sent right now
+    unsigned long txTokensUpdated; // micros() of the last refill
+    TxStats txStats;
+    uint16_t txWindowFrames[TX_CLASS_COUNT];
+    uint16_t txWindowBytes[TX_CLASS_COUNT];
+    unsigned long txWindowStart; // Clock time of the current one second window
+    SAAB_HPD_Timer::TimerId txWindowTimer;
+
+    // Echo verification
+    bool echoCheck;
+    uint8_t echoMaxRetries;
+    uint16_t echoTimeoutMicros; // Time allowed for one byte to come back
+
+    // TX slot, holds the frame in flight until all of it is written (and echoed)
+    uint8_t txBuffer[BUFFER_SIZE + 2];
+    size_t txLength; // 0 when the slot is free
+    size_t txOffset; // Bytes written
+    size_t txEchoOffset; // Bytes whose echo matched
+    TX_CLASS txClassInFlight;
+    uint8_t txAttempts;
+    bool txPaced; // Pacer charged for the current attempt
+    bool txEchoVerify; // Echo is checked for the current attempt
+    bool txExpectsAck; // Slot holds a frame, not raw bytes
+    TxDoneCallback txDone; // Outcome callback of the frame in the slot
+    void* txDoneContext;
+    bool txThrottled;
+    unsigned long txThrottleStart;
+    unsigned long txEchoActivity; // micros() of the last write or echo byte
+    unsigned long rxActivity; // micros() of the last byte read from the line
+
     // Internal methods
     bool readSIDserialData(SerialFrame &frame); // Now private
-    uint8_t calculateChecksum(const SerialFrame &frame);
+    static uint8_t calculateChecksum(const SerialFrame &frame);
+    static void completeFrame(SerialFrame &frame);
     bool verifyChecksum(const SerialFrame &frame);
     bool isValidDLC(uint8_t dlc);
 
-    void processMode(const SerialFrame &frame); // Updates the current mode based on the frame
+    void dispatchFrame(const SerialFrame &frame); // Runs mode detection, events and the frame callback
+    void processMode(const SerialFrame &frame); // Updates the current mode based on the frame, pushes EVENT_MODE_CHANGED
+    Event* pushEvent(EVENT_TYPE type, uint8_t command = 0x00); // nullptr when the queue is full
+    static void onAckTimeout(void* context);
+    static void onSendDone(void* context, ERROR result);
+    void expectAnswer(uint8_t command); // Frame written, its answer is now outstanding
+    void finishAnswer(ERROR result); // Completes the outstanding answer
+    static void onTxWindow(void* context);
+    void rollTxWindow();
+    bool checkDuplicate(const SerialFrame &frame); // Updates the cache, true if content is unchanged
+    void publishFrame(const SerialFrame &frame);
+    void recordHeatmap(bool tx, uint8_t command, const uint8_t* data, size_t dataLength, uint16_t bytes);
+    void recordRawByte(uint8_t byteReceived);
+    void captureParseFailure(PARSE_FAILURE reason, uint8_t stateIndex, const SerialFrame &frame);
+    void invalidateDedup(uint8_t regionID, int32_t subRegion = -1); // -1 drops the whole region
+    void deliverEvents();
+    void startTx(size_t len, TX_CLASS txClass); // Arms the TX slot with txBuffer[0..len)
+    ERROR completeSend(SendResult &result); // Blocking tail of the send functions
+    void serviceTx(); // One step of a blocking send, answers time out without the timers
+    bool pumpTx(); // Writes what fits in the UART FIFO, true when the slot is empty
+    bool checkTxEcho(); // false on echo mismatch
+    bool rxIsEcho(); // false when the RX stream can go to the parser
+    bool takeTxTokens(size_t len); // Non-blocking pacer check
+    void accountTx(TX_CLASS txClass, size_t len);
 
     MODE currentMode; // Stores the current mode based on the last processed frame
 };
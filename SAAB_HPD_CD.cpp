@@ -0,0 +1,134 @@
+#include <SAAB_HPD_CD.h>
+
+// SAAB_HPD_CD class implementation
+
+SAAB_HPD_CD::SAAB_HPD_CD() {
+    reset();
+}
+
+/*!
+  * @brief Update the CD state from a received frame.
+  * @param frame 
+      Any received frame, only 0x11 updates of region 0x01 are looked at.
+  * @return true if the state changed.
+  
+  * @note Hidden sub-regions clear the value they carry, e.g. hiding 0x02EB clears CD_FLAG_RDM.
+!*/
+bool SAAB_HPD_CD::process(const SAAB_HPD::SerialFrame &frame) {
+    if (frame.command != 0x11 || frame.data[0] != 0x01 || frame.dlc < 8) {
+        return false;
+    }
+
+    uint16_t subRegion = (frame.data[2] << 8) | frame.data[3];
+    bool visible = frame.data[4] == HPD_VISIBLE || frame.data[4] == HPD_VISIBLE_2;
+    bool hasText = frame.dlc > 8;
+    char text[BUFFER_SIZE - 8];
+    SAAB_HPD::regionText(frame, text, sizeof(text));
+
+    const CDState &current = state.get();
+    CDState next = current;
+    uint8_t flag = 0;
+    switch (subRegion) {
+        case 0x003C:
+            if (hasText) next.disc = visible ? parseNumber(text) : 0;
+            else if (!visible) next.disc = 0;
+            break;
+        case 0x003D:
+        case 0x003E:
+            if (!visible) {
+                next.track = 0;
+                next.timeValid = false;
+            } else if (hasText) {
+                decodeNumberOrTime(text, next);
+            }
+            break;
+        case 0x02BF: case 0x02C0: case 0x02C1: case 0x02C2: case 0x02C3: case 0x02C4: {
+            uint8_t bit = 1 << (subRegion - 0x02BF);
+            next.magazine = visible ? (next.magazine | bit) : (next.magazine & ~bit);
+            break;
+        }
+        case 0x02CF: if (visible) next.source = SAAB_HPD::MODE_CD; break;
+        case 0x02D0: if (visible) next.source = SAAB_HPD::MODE_CDC; break;
+        case 0x02D2: if (visible) next.source = SAAB_HPD::MODE_CDX; break;
+        case 0x02CD: if (visible) next.source = SAAB_HPD::MODE_UNKNOWN; break; // BT/AUX replaced the CD screen
+        case 0x02DF:
+            if (!visible) {
+                next.status[0] = '\0';
+            } else if (hasText) {
+                memset(next.status, 0, sizeof(next.status));
+                strncpy(next.status, text, sizeof(next.status) - 1);
+            }
+            break;
+        case 0x02EB: flag = CD_FLAG_RDM; break;
+        case 0x02D5: flag = CD_FLAG_SCAN; break;
+        case 0x02ED: flag = CD_FLAG_TP; break;
+        case 0x02EA: flag = CD_FLAG_PTY; break;
+        case 0x02DD: flag = CD_FLAG_NO_CD; break;
+        case 0x02D7: flag = CD_FLAG_CHECKING_MAGAZINE; break;
+        case 0x02D9: flag = CD_FLAG_NO_MAGAZINE; break;
+        default:
+            return false;
+    }
+    if (flag) {
+        next.flags = visible ? (next.flags | flag) : (next.flags & ~flag);
+    }
+
+    if (memcmp(&next, &current, sizeof(next)) == 0) {
+        return false; // Periodic refresh with the same content
+    }
+
+    next.updates++;
+    state.write(next);
+    return true;
+}
+
+/*!
+  * @brief Copy the CD state without locking.
+  * @param out 
+      Receives a consistent copy.
+  * @return void
+  
+  * @note Retries while the writer is updating (seqlock), the writer never waits for readers.
+!*/
+void SAAB_HPD_CD::read(CDState &out) {
+    state.read(out);
+}
+
+uint32_t SAAB_HPD_CD::getVersion() {
+    return state.getVersion();
+}
+
+void SAAB_HPD_CD::reset() {
+    CDState empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.source = SAAB_HPD::MODE_UNKNOWN;
+    state.write(empty);
+}
+
+// Track and time share sub-regions 0x003D/0x003E, "m:ss" is a time, a plain number is the track
+void SAAB_HPD_CD::decodeNumberOrTime(const char* text, CDState &next) {
+    const char* colon = strchr(text, ':');
+    if (colon == nullptr) {
+        next.track = parseNumber(text);
+        return;
+    }
+
+    uint16_t minutes = 0;
+    for (const char* p = text; p < colon; p++) {
+        if (*p >= '0' && *p <= '9') minutes = minutes * 10 + (*p - '0');
+    }
+    next.elapsedSeconds = minutes * 60 + parseNumber(colon + 1);
+    next.timeValid = true;
+}
+
+uint8_t SAAB_HPD_CD::parseNumber(const char* text) {
+    uint16_t value = 0;
+    for (const char* p = text; *p; p++) {
+        if (*p >= '0' && *p <= '9') {
+            value = value * 10 + (*p - '0');
+        } else if (*p != ' ') {
+            break;
+        }
+    }
+    return value > 0xFF ? 0xFF : value;
+}
@@ -0,0 +1,47 @@
+#ifndef SAAB_HPD_CD_H
+#define SAAB_HPD_CD_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Seqlock.h>
+
+// CD state flags, set while the matching sub-region is visible
+#define CD_FLAG_RDM               0x01 // 0x02EB
+#define CD_FLAG_SCAN              0x02 // 0x02D5
+#define CD_FLAG_TP                0x04 // 0x02ED
+#define CD_FLAG_PTY               0x08 // 0x02EA
+#define CD_FLAG_NO_CD             0x10 // 0x02DD
+#define CD_FLAG_CHECKING_MAGAZINE 0x20 // 0x02D7
+#define CD_FLAG_NO_MAGAZINE       0x40 // 0x02D9
+
+// Decodes the ICM CD/CDC/CDX display frames (0x11, region 0x01) into a typed CD state.
+// Uses the sub-regions the ICM creates for the CD screen, the same ones recreateAuxRegion() sets up.
+class SAAB_HPD_CD {
+public:
+    struct CDState {
+        SAAB_HPD::MODE source;   // MODE_CD, MODE_CDC, MODE_CDX or MODE_UNKNOWN
+        uint8_t disc;            // 0x003C, 0 when not shown
+        uint8_t track;           // 0x003D/0x003E, 0 when not shown
+        uint16_t elapsedSeconds; // 0x003D/0x003E "m:ss"
+        bool timeValid;
+        uint8_t magazine;        // Bit n-1 set while disc slot n (0x02BF-0x02C4) is shown
+        uint8_t flags;           // CD_FLAG_*
+        char status[24];         // 0x02DF text, "Play" etc.
+        uint32_t updates;        // Frames that changed the state
+    };
+
+    SAAB_HPD_CD();
+
+    bool process(const SAAB_HPD::SerialFrame &frame); // true if the state changed
+
+    void read(CDState &out); // Lock-free consistent copy, safe from any task
+    uint32_t getVersion();
+    void reset();
+
+private:
+    SAAB_HPD_Seqlock<CDState> state;
+
+    static void decodeNumberOrTime(const char* text, CDState &next);
+    static uint8_t parseNumber(const char* text);
+};
+
+#endif // SAAB_HPD_CD_H
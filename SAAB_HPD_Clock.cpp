@@ -0,0 +1,172 @@
+#include <SAAB_HPD_Clock.h>
+
+// SAAB_HPD_Clock class implementation
+
+SAAB_HPD_Clock::SAAB_HPD_Clock(SAAB_HPD &hpd, uint8_t regionID, uint8_t firstSubRegion)
+    : hpd(hpd), regionID(regionID), firstSubRegion(firstSubRegion), use24Hour(true), running(false),
+      minuteOfDay(0), minuteStart(0), pending(0), inFlight(-1), inFlightDigit(0), minuteTimer(0), sender(hpd, fillFrame, onDone, this), framesSent(0) {
+    memset(shown, 0, sizeof(shown));
+}
+
+/*!
+  * @brief Create the clock sub-regions with the current time.
+  * @param xPos 
+      Left edge of the hour tens digit.
+  * @param yPos 
+      Baseline of the digits.
+  * @param digitWidth 
+      Width of one digit cell, the separator gets half of it.
+  * @return ERROR_OK, or the error of the first sub-region that could not be created.
+  
+  * @note Blocks for the ACK of each sub-region, call it once while setting up the screen.
+!*/
+SAAB_HPD::ERROR SAAB_HPD_Clock::begin(uint16_t xPos, uint8_t yPos, uint8_t digitWidth) {
+    catchUp();
+    char digits[CLOCK_SUBREGIONS];
+    render(digits);
+
+    uint16_t x = xPos;
+    for (uint8_t i = 0; i < CLOCK_SUBREGIONS; i++) {
+        uint8_t width = i == 2 ? digitWidth / 2 : digitWidth;
+        uint8_t font = i < 3 ? HPD_FONT_TIME : HPD_FONT_TIME_2;
+        char text[2] = {digits[i], '\0'};
+        SAAB_HPD::ERROR result = hpd.makeRegion(regionID, 0x02, firstSubRegion + i, x, yPos, width, font, text);
+        if (result != SAAB_HPD::ERROR_OK) {
+            return result;
+        }
+        shown[i] = digits[i];
+        framesSent++;
+        x += width;
+    }
+
+    // Start the minute timer on the phase given to setTime(), the digits may have changed while blocking above
+    running = true;
+    SAAB_HPD_Timer &timers = hpd.getTimers();
+    timers.cancel(minuteTimer);
+    minuteTimer = timers.scheduleAt(minuteStart + 60000UL, onMinute, this, 60000UL);
+    update();
+    return SAAB_HPD::ERROR_OK;
+}
+
+void SAAB_HPD_Clock::end() {
+    running = false;
+    hpd.getTimers().cancel(minuteTimer);
+    minuteTimer = 0;
+    sender.stop();
+}
+
+/*!
+  * @brief Set the wall clock time.
+  * @return void
+  
+  * @note The next minute tick is placed (60 - second) seconds from now and repeats every 60000 ms from there,
+  *       so updates stay on the minute boundary of the clock source without drifting.
+  * @note Before begin() the phase is kept, begin() starts the timer on the same boundary.
+!*/
+void SAAB_HPD_Clock::setTime(uint8_t hour, uint8_t minute, uint8_t second, uint16_t millisecond) {
+    minuteOfDay = (hour % 24) * 60 + minute % 60;
+    uint32_t intoMinute = (second % 60) * 1000UL + millisecond % 1000;
+    minuteStart = hpd.getTimers().now() - intoMinute;
+    if (!running) {
+        return; // begin() starts the timer
+    }
+
+    SAAB_HPD_Timer &timers = hpd.getTimers();
+    timers.cancel(minuteTimer);
+    minuteTimer = timers.scheduleAt(minuteStart + 60000UL, onMinute, this, 60000UL);
+    update();
+}
+
+void SAAB_HPD_Clock::set24Hour(bool enable) {
+    use24Hour = enable;
+    if (running) update();
+}
+
+uint8_t SAAB_HPD_Clock::getHour() {
+    return minuteOfDay / 60;
+}
+
+uint8_t SAAB_HPD_Clock::getMinute() {
+    return minuteOfDay % 60;
+}
+
+uint32_t SAAB_HPD_Clock::getFramesSent() {
+    return framesSent;
+}
+
+void SAAB_HPD_Clock::render(char* digits) {
+    uint8_t hour = minuteOfDay / 60;
+    uint8_t minute = minuteOfDay % 60;
+    if (!use24Hour) {
+        hour %= 12;
+        if (hour == 0) hour = 12;
+    }
+    digits[0] = hour >= 10 ? '0' + hour / 10 : (use24Hour ? '0' : ' ');
+    digits[1] = '0' + hour % 10;
+    digits[2] = ':';
+    digits[3] = '0' + minute / 10;
+    digits[4] = '0' + minute % 10;
+}
+
+// Marks the digits that differ from the SID and starts sending them
+void SAAB_HPD_Clock::update() {
+    char digits[CLOCK_SUBREGIONS];
+    render(digits);
+    for (uint8_t i = 0; i < CLOCK_SUBREGIONS; i++) {
+        if (digits[i] != shown[i]) {
+            pending |= 1 << i;
+        }
+    }
+    sender.send();
+}
+
+// Builds the frame of the next changed digit, one is in flight at a time
+bool SAAB_HPD_Clock::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_Clock* clock = static_cast<SAAB_HPD_Clock*>(context);
+    if (!clock->running || !clock->pending) {
+        return false;
+    }
+    uint8_t i = 0;
+    while (!(clock->pending & (1 << i))) i++;
+
+    char digits[CLOCK_SUBREGIONS];
+    clock->render(digits);
+    char text[2] = {digits[i], '\0'};
+    SAAB_HPD::buildChangeRegion(frame, clock->regionID, 0x02, clock->firstSubRegion + i, HPD_VISIBLE, HPD_STYLE_NORMAL, text);
+    clock->inFlight = i;
+    clock->inFlightDigit = digits[i];
+    clock->framesSent++;
+    return true;
+}
+
+void SAAB_HPD_Clock::catchUp() {
+    uint32_t minutes = (hpd.getTimers().now() - minuteStart) / 60000UL;
+    minuteStart += minutes * 60000UL;
+    minuteOfDay = (minuteOfDay + minutes % (24 * 60)) % (24 * 60);
+}
+
+void SAAB_HPD_Clock::onMinute(void* context) {
+    SAAB_HPD_Clock* clock = static_cast<SAAB_HPD_Clock*>(context);
+    clock->minuteStart += 60000UL;
+    clock->minuteOfDay = (clock->minuteOfDay + 1) % (24 * 60);
+    clock->update();
+}
+
+// A digit only counts as shown once the SID acknowledged it, anything else sends it again
+void SAAB_HPD_Clock::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Clock* clock = static_cast<SAAB_HPD_Clock*>(context);
+    uint8_t i = clock->inFlight;
+    clock->inFlight = -1;
+    if (result != SAAB_HPD::ERROR_OK) {
+        clock->shown[i] = 0; // Unknown, the frame may or may not have been taken
+        clock->pending |= 1 << i;
+        return;
+    }
+
+    clock->shown[i] = clock->inFlightDigit;
+    char digits[CLOCK_SUBREGIONS];
+    clock->render(digits);
+    if (digits[i] == clock->shown[i]) {
+        clock->pending &= ~(1 << i);
+    }
+}
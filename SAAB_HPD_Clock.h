@@ -0,0 +1,52 @@
+#ifndef SAAB_HPD_CLOCK_H
+#define SAAB_HPD_CLOCK_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+
+// Sub-regions used by the clock: hour tens, hour units, separator, minute tens, minute units
+#define CLOCK_SUBREGIONS 5
+
+// Clock on the SID in the split time fonts, hours in HPD_FONT_TIME and minutes in HPD_FONT_TIME_2.
+// Every digit is its own sub-region, created once by begin(). A repeating timer on the SAAB_HPD
+// wheel fires on each minute boundary and only the digits that changed are sent.
+class SAAB_HPD_Clock {
+public:
+    SAAB_HPD_Clock(SAAB_HPD &hpd, uint8_t regionID = 0x01, uint8_t firstSubRegion = 0xA0);
+
+    // Creates the sub-regions, digitWidth is the cell width of one digit in pixels
+    SAAB_HPD::ERROR begin(uint16_t xPos, uint8_t yPos, uint8_t digitWidth = 8);
+    void end(); // Stops the minute timer, the sub-regions stay on the SID
+
+    void setTime(uint8_t hour, uint8_t minute, uint8_t second = 0, uint16_t millisecond = 0); // Aligns the minute timer
+    void set24Hour(bool enable); // 12 hour mode hides a leading zero
+    uint8_t getHour();
+    uint8_t getMinute();
+
+    uint32_t getFramesSent();
+
+private:
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    uint8_t firstSubRegion;
+    bool use24Hour;
+    bool running;
+    uint16_t minuteOfDay;
+    unsigned long minuteStart; // Clock time minuteOfDay began, keeps the phase set before begin()
+    char shown[CLOCK_SUBREGIONS]; // Character acknowledged by the SID per sub-region, 0 when unknown
+    uint8_t pending; // Bit per sub-region still to send
+    int8_t inFlight; // Sub-region waiting for its answer, -1 for none
+    char inFlightDigit;
+    SAAB_HPD_Timer::TimerId minuteTimer;
+    SAAB_HPD_Sender sender;
+    uint32_t framesSent;
+
+    void render(char* digits);
+    void update();
+    void catchUp(); // Counts the minutes that passed since minuteStart
+    static void onMinute(void* context);
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_CLOCK_H
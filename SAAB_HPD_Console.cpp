@@ -0,0 +1,182 @@
+#include <SAAB_HPD_Console.h>
+
+// SAAB_HPD_Console class implementation
+
+SAAB_HPD_Console::SAAB_HPD_Console(SAAB_HPD &hpd, uint8_t regionID)
+    : hpd(hpd), regionID(regionID), rowCount(0), columns(CONSOLE_COLUMNS), head(0), lineCount(1), scrollOffset(0),
+      budget(4, 2), wakeTimer(0), inFlight(-1), sender(hpd, fillFrame, onDone, this), framesSent(0) {
+    memset(lines, 0, sizeof(lines));
+    inFlightText[0] = '\0';
+}
+
+bool SAAB_HPD_Console::addRow(uint8_t subRegionID0, uint8_t subRegionID1, uint8_t columns) {
+    if (rowCount == CONSOLE_MAX_ROWS) {
+        return false;
+    }
+    Row &row = rows[rowCount++];
+    row.subRegionID0 = subRegionID0;
+    row.subRegionID1 = subRegionID1;
+    row.shown[0] = '\0';
+    row.shownValid = false;
+    if (columns > 0 && columns < this->columns) this->columns = columns;
+    budget.fill(hpd.getTimers().now());
+    refresh();
+    return true;
+}
+
+void SAAB_HPD_Console::setBudget(uint8_t framesPerSecond, uint8_t burst) {
+    budget.setRate(framesPerSecond, burst, hpd.getTimers().now());
+}
+
+size_t SAAB_HPD_Console::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+/*!
+  * @brief Append text, called by print(), println() and printf().
+  * @return size, the console never refuses output.
+  
+  * @note Never blocks. A changed row is queued right away while the budget and the TX slot allow it,
+  *       the rest follows from poll() as answers arrive and tokens refill.
+!*/
+size_t SAAB_HPD_Console::write(const uint8_t* buffer, size_t size) {
+    uint8_t skippedBefore = skippedLines();
+    uint16_t added = 0;
+    for (size_t i = 0; i < size; i++) {
+        char c = buffer[i];
+        if (c == '\n') {
+            newLine();
+            added++;
+        } else if (c == '\r') {
+            continue;
+        } else {
+            char* line = lines[head];
+            size_t len = strlen(line);
+            if (len >= columns) {
+                newLine(); // Wrap
+                added++;
+                line = lines[head];
+                len = 0;
+            }
+            line[len] = (c < 0x20) ? ' ' : c;
+            line[len + 1] = '\0';
+        }
+    }
+
+    // Keep a scrolled back view on the same lines, as far as the scrollback still holds them
+    if (scrollOffset > 0) {
+        int16_t offset = scrollOffset + added + skippedBefore - skippedLines();
+        int16_t maxOffset = maxScrollOffset();
+        scrollOffset = offset > maxOffset ? maxOffset : offset;
+    }
+    refresh();
+    return size;
+}
+
+void SAAB_HPD_Console::clear() {
+    memset(lines, 0, sizeof(lines));
+    head = 0;
+    lineCount = 1;
+    scrollOffset = 0;
+    refresh();
+}
+
+void SAAB_HPD_Console::scroll(int16_t lines) {
+    int16_t offset = lines <= 0 ? 0 : lines;
+    int16_t maxOffset = maxScrollOffset();
+    if (offset > maxOffset) offset = maxOffset;
+    scrollOffset = offset;
+    refresh();
+}
+
+uint8_t SAAB_HPD_Console::getScrollOffset() {
+    return scrollOffset;
+}
+
+const char* SAAB_HPD_Console::getLine(uint8_t age) {
+    if (age >= lineCount) {
+        return nullptr;
+    }
+    return lines[(head + CONSOLE_SCROLLBACK - age) % CONSOLE_SCROLLBACK];
+}
+
+uint32_t SAAB_HPD_Console::getFramesSent() {
+    return framesSent;
+}
+
+void SAAB_HPD_Console::newLine() {
+    head = (head + 1) % CONSOLE_SCROLLBACK;
+    lines[head][0] = '\0';
+    if (lineCount < CONSOLE_SCROLLBACK) lineCount++;
+}
+
+uint8_t SAAB_HPD_Console::skippedLines() {
+    return (lines[head][0] == '\0' && lineCount > 1) ? 1 : 0;
+}
+
+uint8_t SAAB_HPD_Console::maxScrollOffset() {
+    // The skipped empty line is not history, the top row shows the oldest line at the maximum offset
+    uint8_t history = lineCount - skippedLines();
+    return history > rowCount ? history - rowCount : 0;
+}
+
+const char* SAAB_HPD_Console::rowText(uint8_t row) {
+    // The bottom row shows the newest line, an empty line after println() is skipped
+    uint8_t age = skippedLines() + scrollOffset + (rowCount - 1 - row);
+    const char* line = getLine(age);
+    return line ? line : "";
+}
+
+void SAAB_HPD_Console::refresh() {
+    sender.send();
+}
+
+// Builds the frame of the next changed row, bottom first since the newest output matters most
+bool SAAB_HPD_Console::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_Console* console = static_cast<SAAB_HPD_Console*>(context);
+    SAAB_HPD_Timer &timers = console->hpd.getTimers();
+    if (timers.isScheduled(console->wakeTimer)) {
+        return false; // Waiting for the budget, rows are compared again on wake up
+    }
+
+    for (int8_t r = console->rowCount - 1; r >= 0; r--) {
+        Row &row = console->rows[r];
+        const char* text = console->rowText(r);
+        if (row.shownValid && strcmp(text, row.shown) == 0) {
+            continue;
+        }
+
+        uint32_t wait = console->budget.wait(timers.now());
+        if (wait > 0) {
+            console->wakeTimer = timers.schedule(wait, onWake, console);
+            return false;
+        }
+
+        SAAB_HPD::buildChangeRegion(frame, console->regionID, row.subRegionID0, row.subRegionID1, HPD_VISIBLE, HPD_STYLE_NORMAL, text);
+        console->budget.take();
+        console->inFlight = r;
+        strcpy(console->inFlightText, text);
+        console->framesSent++;
+        return true;
+    }
+    return false;
+}
+
+// A row only counts as shown once the SID acknowledged it, anything else sends it again
+void SAAB_HPD_Console::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Console* console = static_cast<SAAB_HPD_Console*>(context);
+    Row &row = console->rows[console->inFlight];
+    console->inFlight = -1;
+    if (result != SAAB_HPD::ERROR_OK) {
+        row.shownValid = false;
+        return;
+    }
+    strcpy(row.shown, console->inFlightText);
+    row.shownValid = true;
+}
+
+void SAAB_HPD_Console::onWake(void* context) {
+    SAAB_HPD_Console* console = static_cast<SAAB_HPD_Console*>(context);
+    console->wakeTimer = 0;
+    console->refresh();
+}
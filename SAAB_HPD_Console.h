@@ -0,0 +1,73 @@
+#ifndef SAAB_HPD_CONSOLE_H
+#define SAAB_HPD_CONSOLE_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+#include <SAAB_HPD_TokenBucket.h>
+
+// Text rows the console can draw on
+#define CONSOLE_MAX_ROWS 4
+
+// Characters per line and lines kept in RAM
+#define CONSOLE_COLUMNS 40
+#define CONSOLE_SCROLLBACK 32
+
+// Small terminal on SID text rows, use it like Serial: console.printf("ACK %u\n", n)
+// Lines wrap at the narrowest row and scroll up, the last CONSOLE_SCROLLBACK lines stay in RAM.
+// Rows are compared with what the SID shows and only changed rows are sent, limited by a frame budget,
+// so a burst of log output never blocks and costs at most the budget.
+class SAAB_HPD_Console : public Print {
+public:
+    SAAB_HPD_Console(SAAB_HPD &hpd, uint8_t regionID = 0x01);
+
+    bool addRow(uint8_t subRegionID0, uint8_t subRegionID1, uint8_t columns); // Top to bottom, sub-regions created by the application
+    void setBudget(uint8_t framesPerSecond, uint8_t burst = 2); // 4 frames per second and a burst of 2 by default
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    void clear();
+    void scroll(int16_t lines); // Positive scrolls back into the history, 0 follows the output again
+    uint8_t getScrollOffset();
+    const char* getLine(uint8_t age); // 0 is the line being written, nullptr beyond the scrollback
+
+    uint32_t getFramesSent();
+
+private:
+    struct Row {
+        uint8_t subRegionID0;
+        uint8_t subRegionID1;
+        char shown[CONSOLE_COLUMNS + 1]; // Acknowledged by the SID
+        bool shownValid;
+    };
+
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    Row rows[CONSOLE_MAX_ROWS];
+    uint8_t rowCount;
+    uint8_t columns; // Narrowest row
+
+    char lines[CONSOLE_SCROLLBACK][CONSOLE_COLUMNS + 1];
+    uint8_t head; // Line being written
+    uint8_t lineCount; // Lines held, including the one being written
+    uint8_t scrollOffset;
+
+    SAAB_HPD_TokenBucket budget;
+    SAAB_HPD_Timer::TimerId wakeTimer;
+    int8_t inFlight; // Row waiting for its answer, -1 for none
+    char inFlightText[CONSOLE_COLUMNS + 1];
+    SAAB_HPD_Sender sender;
+    uint32_t framesSent;
+
+    void newLine();
+    uint8_t skippedLines(); // 1 while the line being written is the empty line after println()
+    uint8_t maxScrollOffset();
+    const char* rowText(uint8_t row); // Line shown on a row for the current scroll offset
+    void refresh(); // Sends changed rows as far as the budget allows
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+    static void onWake(void* context);
+};
+
+#endif // SAAB_HPD_CONSOLE_H
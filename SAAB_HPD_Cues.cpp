@@ -0,0 +1,174 @@
+#include <SAAB_HPD_Cues.h>
+
+// SAAB_HPD_Cues class implementation
+
+SAAB_HPD_Cues::SAAB_HPD_Cues(SAAB_HPD &hpd)
+    : hpd(hpd), cueCount(0), nextCue(0), inFlight(-1), answerPending(false), playing(false), origin(0), sentAt(0),
+      srtt8(CUE_INITIAL_RTT_MS * 8), latenessSum(0), encodedLength(0), sendTimer(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool SAAB_HPD_Cues::addCue(uint32_t at, const char* text, uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1) {
+    if (cueCount == CUE_MAX) {
+        return false;
+    }
+
+    // Insertion keeps the timeline sorted, cues are usually added in order
+    uint8_t i = cueCount;
+    while (i > 0 && cues[i - 1].at > at) {
+        cues[i] = cues[i - 1];
+        i--;
+    }
+    Cue &cue = cues[i];
+    cue.at = at;
+    cue.text = text;
+    cue.regionID = regionID;
+    cue.subRegionID0 = subRegionID0;
+    cue.subRegionID1 = subRegionID1;
+    cue.lateness = 0;
+    cue.played = false;
+    cueCount++;
+    return true;
+}
+
+void SAAB_HPD_Cues::clear() {
+    stop();
+    cueCount = 0;
+}
+
+/*!
+  * @brief Start playing the timeline.
+  * @param position 
+      ms into the timeline, cues before it are skipped.
+  * @return false if every cue lies before position.
+  
+  * @note Statistics are reset, the round trip estimate is kept.
+  * @note Each cue is matched to its own answer through the done callback of the queued frame.
+!*/
+bool SAAB_HPD_Cues::start(uint32_t position) {
+    stop();
+
+    memset(&stats, 0, sizeof(stats));
+    latenessSum = 0;
+    origin = hpd.getTimers().now() - position;
+    nextCue = 0;
+    for (uint8_t i = 0; i < cueCount; i++) {
+        cues[i].played = false;
+        if (cues[i].at < position) nextCue = i + 1;
+    }
+    if (nextCue >= cueCount) {
+        return false;
+    }
+    playing = true;
+    prepareNext();
+    return true;
+}
+
+void SAAB_HPD_Cues::stop() {
+    hpd.getTimers().cancel(sendTimer);
+    inFlight = -1;
+    playing = false;
+}
+
+bool SAAB_HPD_Cues::isPlaying() {
+    return playing;
+}
+
+uint32_t SAAB_HPD_Cues::getPosition() {
+    return hpd.getTimers().now() - origin;
+}
+
+const SAAB_HPD_Cues::Cue* SAAB_HPD_Cues::getCue(uint8_t index) {
+    return index < cueCount ? &cues[index] : nullptr;
+}
+
+uint8_t SAAB_HPD_Cues::getCueCount() {
+    return cueCount;
+}
+
+const SAAB_HPD_Cues::CueStats& SAAB_HPD_Cues::getStats() {
+    stats.rtt = (srtt8 + 4) / 8;
+    return stats;
+}
+
+// Encodes the next cue and schedules its send one round trip before its time
+void SAAB_HPD_Cues::prepareNext() {
+    if (nextCue >= cueCount) {
+        if (inFlight < 0) stop(); // Timeline done
+        return;
+    }
+
+    const Cue &cue = cues[nextCue];
+    SAAB_HPD::SerialFrame frame;
+    SAAB_HPD::buildChangeRegion(frame, cue.regionID, cue.subRegionID0, cue.subRegionID1, HPD_VISIBLE, HPD_STYLE_NORMAL, cue.text);
+    encodedLength = SAAB_HPD::serializeFrame(frame, encoded);
+
+    uint32_t rtt = (srtt8 + 4) / 8;
+    sendTimer = hpd.getTimers().scheduleAt(origin + cue.at - rtt, onSend, this);
+}
+
+void SAAB_HPD_Cues::send() {
+    SAAB_HPD_Timer &timers = hpd.getTimers();
+    if (answerPending || !hpd.queueEncodedSidData(encoded, encodedLength, onAnswer, this)) {
+        sendTimer = timers.schedule(1, onSend, this); // Previous cue or another frame still in flight
+        return;
+    }
+
+    sentAt = timers.now();
+    answerPending = true;
+    inFlight = nextCue++;
+    prepareNext();
+}
+
+// Answer to the cue in flight, only an ACK is a round trip sample
+void SAAB_HPD_Cues::onAnswer(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Cues* player = static_cast<SAAB_HPD_Cues*>(context);
+    player->answerPending = false;
+    if (player->inFlight < 0) {
+        return; // Stopped while the frame was in flight
+    }
+
+    unsigned long now = player->hpd.getTimers().now();
+    if (result == SAAB_HPD::ERROR_OK) {
+        // Round trip, smoothed with a gain of 1/8
+        int32_t sample = now - player->sentAt;
+        player->srtt8 += sample - (int32_t)(player->srtt8 / 8);
+        player->finish((int32_t)(now - (player->origin + player->cues[player->inFlight].at)), result);
+    } else {
+        player->finish(CUE_NO_ANSWER, result);
+    }
+}
+
+void SAAB_HPD_Cues::finish(int32_t lateness, SAAB_HPD::ERROR result) {
+    // A late answer (e.g. after a stalled loop) must not wrap into an early one
+    if (lateness > CUE_NO_ANSWER - 1) lateness = CUE_NO_ANSWER - 1;
+    if (lateness < -CUE_NO_ANSWER) lateness = -CUE_NO_ANSWER;
+
+    Cue &cue = cues[inFlight];
+    cue.played = true;
+    inFlight = -1;
+
+    if (result == SAAB_HPD::ERROR_TIMEOUT || result == SAAB_HPD::ERROR_COLLISION) {
+        cue.lateness = CUE_NO_ANSWER;
+        stats.unanswered++;
+    } else if (result != SAAB_HPD::ERROR_OK) {
+        cue.lateness = CUE_NO_ANSWER;
+        stats.nacked++;
+    } else {
+        cue.lateness = lateness;
+        if (stats.played == 0 || lateness < stats.minLateness) stats.minLateness = lateness;
+        if (stats.played == 0 || lateness > stats.maxLateness) stats.maxLateness = lateness;
+        stats.played++;
+        latenessSum += lateness;
+        stats.meanLateness = latenessSum / stats.played;
+        if (lateness > CUE_LATE_MS) stats.late++;
+    }
+
+    if (nextCue >= cueCount) {
+        stop(); // Last cue answered
+    }
+}
+
+void SAAB_HPD_Cues::onSend(void* context) {
+    static_cast<SAAB_HPD_Cues*>(context)->send();
+}
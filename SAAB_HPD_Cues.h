@@ -0,0 +1,83 @@
+#ifndef SAAB_HPD_CUES_H
+#define SAAB_HPD_CUES_H
+
+#include <SAAB_HPD.h>
+
+// Cues in one timeline
+#define CUE_MAX 64
+
+// A cue acknowledged later than this after its time counts as late
+#define CUE_LATE_MS 20
+
+// Round trip assumed before the first measurement
+#define CUE_INITIAL_RTT_MS 10
+
+// Cue lateness of a frame the SID never answered or refused, measured lateness is clamped below it
+#define CUE_NO_ANSWER 0x7FFF
+
+// Plays a timeline of texts (synced lyrics, timed prompts) on the SID.
+// The next cue is encoded as soon as the previous one is out, and sent early by the measured round trip
+// (write to ACK, smoothed like TCP SRTT) so its ACK lands on the cue time. Lateness is recorded per cue.
+class SAAB_HPD_Cues {
+public:
+    struct Cue {
+        uint32_t at; // ms from the start of the timeline
+        const char* text; // Must stay valid while the timeline plays
+        uint8_t regionID;
+        uint8_t subRegionID0;
+        uint8_t subRegionID1;
+        int16_t lateness; // ms from the cue time to the ACK, CUE_NO_ANSWER without ACK
+        bool played;
+    };
+
+    struct CueStats {
+        uint16_t played;
+        uint16_t late; // Later than CUE_LATE_MS
+        uint16_t nacked; // Refused by the SID, not a round trip sample
+        uint16_t unanswered; // Timed out or dropped after collisions
+        int16_t minLateness;
+        int16_t maxLateness;
+        int16_t meanLateness;
+        uint16_t rtt; // Current round trip estimate in ms
+    };
+
+    SAAB_HPD_Cues(SAAB_HPD &hpd);
+
+    bool addCue(uint32_t at, const char* text, uint8_t regionID = 0x01, uint8_t subRegionID0 = 0x02, uint8_t subRegionID1 = 0xDF); // Kept sorted, false when full
+    void clear();
+
+    bool start(uint32_t position = 0); // Plays from position ms into the timeline, false if no cue is left after it
+    void stop();
+    bool isPlaying();
+    uint32_t getPosition(); // ms into the timeline
+
+    const Cue* getCue(uint8_t index);
+    uint8_t getCueCount();
+    const CueStats& getStats();
+
+private:
+    SAAB_HPD &hpd;
+    Cue cues[CUE_MAX];
+    uint8_t cueCount;
+    uint8_t nextCue; // First cue not sent yet
+    int16_t inFlight; // Cue waiting for its ACK, -1 if none
+    bool answerPending; // Our frame is unanswered, also after stop()
+    bool playing;
+    unsigned long origin; // Clock time of timeline position 0
+    unsigned long sentAt;
+    uint32_t srtt8; // Smoothed round trip, ms * 8
+    int32_t latenessSum;
+    CueStats stats;
+
+    uint8_t encoded[BUFFER_SIZE + 2]; // Wire bytes of nextCue
+    size_t encodedLength;
+    SAAB_HPD_Timer::TimerId sendTimer;
+
+    void prepareNext();
+    void send();
+    void finish(int32_t lateness, SAAB_HPD::ERROR result);
+    static void onSend(void* context);
+    static void onAnswer(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_CUES_H
@@ -0,0 +1,102 @@
+#include <SAAB_HPD_FrameCache.h>
+
+// SAAB_HPD_FrameCache class implementation
+
+SAAB_HPD_FrameCache::SAAB_HPD_FrameCache(SAAB_HPD &hpd)
+    : hpd(hpd) {
+    clear();
+}
+
+/*!
+  * @brief Change a sub-region like SAAB_HPD::changeRegion, sending a cached frame when there is one.
+  * @return ERROR
+      Same as SAAB_HPD::sendSidData.
+!*/
+SAAB_HPD::ERROR SAAB_HPD_FrameCache::changeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text) {
+    uint8_t length;
+    const uint8_t* bytes = lookup(regionID, subRegionID0, subRegionID1, visible, style, text, length);
+    if (!bytes) {
+        return hpd.sendPreparedSidData(scratch);
+    }
+    return hpd.sendEncodedSidData(bytes, length);
+}
+
+bool SAAB_HPD_FrameCache::queueChangeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text) {
+    if (hpd.isTxBusy()) {
+        return false; // Do not count a lookup that is retried
+    }
+    uint8_t length;
+    const uint8_t* bytes = lookup(regionID, subRegionID0, subRegionID1, visible, style, text, length);
+    if (!bytes) {
+        return hpd.queuePreparedSidData(scratch);
+    }
+    return hpd.queueEncodedSidData(bytes, length);
+}
+
+uint32_t SAAB_HPD_FrameCache::getHits() {
+    return hits;
+}
+
+uint32_t SAAB_HPD_FrameCache::getMisses() {
+    return misses;
+}
+
+uint8_t SAAB_HPD_FrameCache::getHitRate() {
+    uint32_t total = hits + misses;
+    return total ? (uint64_t)hits * 100 / total : 0;
+}
+
+void SAAB_HPD_FrameCache::clear() {
+    memset(entries, 0, sizeof(entries));
+    useCounter = 0;
+    hits = 0;
+    misses = 0;
+}
+
+const uint8_t* SAAB_HPD_FrameCache::lookup(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text, uint8_t &length) {
+    // FNV-1a over the text, measuring it on the way
+    uint32_t textHash = 2166136261UL;
+    size_t textLength = 0;
+    while (text && text[textLength]) {
+        textHash = (textHash ^ (uint8_t)text[textLength]) * 16777619UL;
+        textLength++;
+    }
+
+    uint32_t key = (0x11UL << 24) | ((uint32_t)regionID << 16) | ((uint32_t)subRegionID0 << 8) | subRegionID1;
+    uint16_t format = ((uint16_t)visible << 8) | style;
+    useCounter++;
+
+    // Wire layout of 0x11: DLC, command, padding, 6 header bytes, text, checksum
+    const size_t textOffset = 9;
+    if (textOffset + textLength + 1 > FRAME_CACHE_MAX_BYTES) {
+        misses++;
+        SAAB_HPD::buildChangeRegion(scratch, regionID, subRegionID0, subRegionID1, visible, style, text);
+        return nullptr;
+    }
+
+    Entry* victim = &entries[0];
+    for (uint8_t i = 0; i < FRAME_CACHE_ENTRIES; i++) {
+        Entry &entry = entries[i];
+        if (entry.lastUsed && entry.key == key && entry.format == format && entry.textHash == textHash &&
+            entry.length == textOffset + textLength + 1 && memcmp(&entry.bytes[textOffset], text, textLength) == 0) {
+            hits++;
+            entry.lastUsed = useCounter;
+            length = entry.length;
+            return entry.bytes;
+        }
+        if (entry.lastUsed < victim->lastUsed) {
+            victim = &entry; // Empty entries have lastUsed 0 and go first
+        }
+    }
+
+    misses++;
+    SAAB_HPD::SerialFrame frame;
+    SAAB_HPD::buildChangeRegion(frame, regionID, subRegionID0, subRegionID1, visible, style, text);
+    victim->key = key;
+    victim->format = format;
+    victim->textHash = textHash;
+    victim->lastUsed = useCounter;
+    victim->length = SAAB_HPD::serializeFrame(frame, victim->bytes);
+    length = victim->length;
+    return victim->bytes;
+}
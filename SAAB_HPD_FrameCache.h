@@ -0,0 +1,48 @@
+#ifndef SAAB_HPD_FRAMECACHE_H
+#define SAAB_HPD_FRAMECACHE_H
+
+#include <SAAB_HPD.h>
+
+// Encoded frames kept, least recently used is replaced first
+#define FRAME_CACHE_ENTRIES 16
+
+// Longest frame kept on the wire, 0x11 with up to 40 characters of text
+#define FRAME_CACHE_MAX_BYTES 52
+
+// LRU cache of fully encoded 0x11 frames keyed by (command, region, sub-region, visibility, style, text hash).
+// A hit costs a lookup and a single copy into the TX slot, no encoding and no checksum.
+// Texts longer than the cache entries are encoded and sent every time.
+class SAAB_HPD_FrameCache {
+public:
+    SAAB_HPD_FrameCache(SAAB_HPD &hpd);
+
+    SAAB_HPD::ERROR changeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text = nullptr);
+    bool queueChangeRegion(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text = nullptr); // false while the TX slot is busy
+
+    uint32_t getHits();
+    uint32_t getMisses();
+    uint8_t getHitRate(); // Percent of lookups that hit
+    void clear(); // Drops every entry and the counters
+
+private:
+    struct Entry {
+        uint32_t key; // command, region, sub-regions
+        uint32_t textHash; // FNV-1a over the text
+        uint16_t format; // visibility, style
+        uint32_t lastUsed; // 0 when the entry is empty
+        uint8_t length;
+        uint8_t bytes[FRAME_CACHE_MAX_BYTES];
+    };
+
+    SAAB_HPD &hpd;
+    Entry entries[FRAME_CACHE_ENTRIES];
+    uint32_t useCounter;
+    uint32_t hits;
+    uint32_t misses;
+    SAAB_HPD::SerialFrame scratch; // Frame for texts too long to cache
+
+    // Returns the wire bytes for the frame, from the cache or freshly encoded, nullptr if it only fits in scratch
+    const uint8_t* lookup(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1, uint8_t visible, uint8_t style, const char* text, uint8_t &length);
+};
+
+#endif // SAAB_HPD_FRAMECACHE_H
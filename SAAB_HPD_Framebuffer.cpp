@@ -0,0 +1,277 @@
+#include <SAAB_HPD_Framebuffer.h>
+
+// SAAB_HPD_Framebuffer class implementation
+
+SAAB_HPD_Framebuffer::SAAB_HPD_Framebuffer(SAAB_HPD &hpd, uint8_t regionID, RAW_FORMAT format)
+    : hpd(hpd), regionID(regionID), format(format), dirtyCount(0), framesSent(0), bytesSent(0) {
+    memset(pixels, 0, sizeof(pixels));
+}
+
+void SAAB_HPD_Framebuffer::setFormat(RAW_FORMAT format) {
+    this->format = format;
+    markDirty(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT); // The SID has to get everything in the new layout
+}
+
+SAAB_HPD_Framebuffer::RAW_FORMAT SAAB_HPD_Framebuffer::getFormat() {
+    return format;
+}
+
+void SAAB_HPD_Framebuffer::clear(bool on) {
+    memset(pixels, on ? 0xFF : 0x00, sizeof(pixels));
+    markDirty(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+}
+
+void SAAB_HPD_Framebuffer::setPixel(int16_t x, int16_t y, bool on) {
+    if (x < 0 || y < 0 || x >= FRAMEBUFFER_WIDTH || y >= FRAMEBUFFER_HEIGHT) return;
+    uint8_t &b = pixels[y * (FRAMEBUFFER_WIDTH / 8) + x / 8];
+    uint8_t mask = 0x80 >> (x & 7);
+    if (((b & mask) != 0) == on) return; // Unchanged pixels do not make the area dirty
+    b ^= mask;
+    markDirty(x, y, 1, 1);
+}
+
+bool SAAB_HPD_Framebuffer::getPixel(int16_t x, int16_t y) {
+    if (x < 0 || y < 0 || x >= FRAMEBUFFER_WIDTH || y >= FRAMEBUFFER_HEIGHT) return false;
+    return pixels[y * (FRAMEBUFFER_WIDTH / 8) + x / 8] & (0x80 >> (x & 7));
+}
+
+void SAAB_HPD_Framebuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, bool on) {
+    for (int16_t row = y; row < y + h; row++) {
+        for (int16_t col = x; col < x + w; col++) {
+            setPixel(col, row, on);
+        }
+    }
+}
+
+void SAAB_HPD_Framebuffer::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h) {
+    int16_t bytesPerRow = (w + 7) / 8;
+    for (int16_t row = 0; row < h; row++) {
+        for (int16_t col = 0; col < w; col++) {
+            setPixel(x + col, y + row, bitmap[row * bytesPerRow + col / 8] & (0x80 >> (col & 7)));
+        }
+    }
+}
+
+/*!
+  * @brief Add an area to the dirty list.
+  * @return void
+  
+  * @note Touching or overlapping rectangles are merged, when the list is full the new area joins the rectangle that grows the least.
+!*/
+void SAAB_HPD_Framebuffer::markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    // Clip to the panel
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > FRAMEBUFFER_WIDTH) w = FRAMEBUFFER_WIDTH - x;
+    if (y + h > FRAMEBUFFER_HEIGHT) h = FRAMEBUFFER_HEIGHT - y;
+    if (w <= 0 || h <= 0) return;
+
+    Rect r = {(uint16_t)x, (uint16_t)y, (uint16_t)w, (uint16_t)h};
+
+    // Merge with every rectangle it touches, the union can touch more, so repeat
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (uint8_t i = 0; i < dirtyCount; i++) {
+            if (touches(r, dirty[i])) {
+                r = unite(r, dirty[i]);
+                dirty[i] = dirty[--dirtyCount];
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (dirtyCount < FRAMEBUFFER_MAX_DIRTY) {
+        dirty[dirtyCount++] = r;
+        return;
+    }
+
+    uint8_t best = 0;
+    uint32_t bestGrowth = UINT32_MAX;
+    for (uint8_t i = 0; i < dirtyCount; i++) {
+        uint32_t growth = area(unite(r, dirty[i])) - area(dirty[i]);
+        if (growth < bestGrowth) {
+            bestGrowth = growth;
+            best = i;
+        }
+    }
+    dirty[best] = unite(r, dirty[best]);
+}
+
+uint8_t SAAB_HPD_Framebuffer::getDirtyCount() {
+    return dirtyCount;
+}
+
+const SAAB_HPD_Framebuffer::Rect* SAAB_HPD_Framebuffer::getDirty(uint8_t index) {
+    return index < dirtyCount ? &dirty[index] : nullptr;
+}
+
+struct FlushContext {
+    SAAB_HPD* hpd;
+    SAAB_HPD::ERROR result;
+    uint32_t frames;
+    uint32_t bytes;
+};
+
+static void sendRawFrame(const SAAB_HPD::SerialFrame &frame, void* context) {
+    FlushContext* ctx = static_cast<FlushContext*>(context);
+    if (ctx->result != SAAB_HPD::ERROR_OK) return; // An earlier chunk failed
+    SAAB_HPD::SerialFrame copy = frame;
+    ctx->result = ctx->hpd->sendSidData(copy);
+    ctx->frames++;
+    ctx->bytes += frame.dlc + 2;
+}
+
+/*!
+  * @brief Send every dirty area with 0x40 frames.
+  * @return ERROR_OK when all areas were acknowledged, otherwise the first error.
+  
+  * @note An area whose frames were not all acknowledged stays dirty, so the next flush() sends it again.
+!*/
+SAAB_HPD::ERROR SAAB_HPD_Framebuffer::flush() {
+    while (dirtyCount > 0) {
+        FlushContext ctx = {&hpd, SAAB_HPD::ERROR_OK, 0, 0};
+        encode(dirty[dirtyCount - 1], sendRawFrame, &ctx);
+        framesSent += ctx.frames;
+        bytesSent += ctx.bytes;
+        if (ctx.result != SAAB_HPD::ERROR_OK) {
+            return ctx.result;
+        }
+        dirtyCount--;
+    }
+    return SAAB_HPD::ERROR_OK;
+}
+
+/*!
+  * @brief Encode one area in the current format.
+  * @param rect 
+      Area to send, widened to the byte boundaries of the format.
+  * @param emit 
+      Called for every frame, the frame is only valid during the call.
+  * @param context 
+      Passed to emit.
+  * @return The number of frames emitted.
+  
+  * @note Areas larger than FRAMEBUFFER_MAX_PAYLOAD are split into several frames.
+!*/
+uint16_t SAAB_HPD_Framebuffer::encode(const Rect &rect, void (*emit)(const SAAB_HPD::SerialFrame &frame, void* context), void* context) {
+    Rect r = align(rect);
+    SAAB_HPD::SerialFrame frame;
+    frame.command = 0x40;
+    frame.data[0] = regionID;
+    frame.data[1] = 0x00;
+    uint16_t frames = 0;
+
+    if (format == RAW_FORMAT_ROWS) {
+        const uint8_t header = 6;
+        uint16_t bytesPerRow = r.w / 8;
+        uint16_t rowsPerFrame = (FRAMEBUFFER_MAX_PAYLOAD - header) / bytesPerRow;
+        for (uint16_t y = r.y; y < r.y + r.h; y += rowsPerFrame) {
+            uint16_t rows = r.y + r.h - y;
+            if (rows > rowsPerFrame) rows = rowsPerFrame;
+            frame.data[2] = r.x / 8;
+            frame.data[3] = y;
+            frame.data[4] = bytesPerRow;
+            frame.data[5] = rows;
+            uint16_t n = header;
+            for (uint16_t row = y; row < y + rows; row++) {
+                memcpy(&frame.data[n], &pixels[row * (FRAMEBUFFER_WIDTH / 8) + r.x / 8], bytesPerRow);
+                n += bytesPerRow;
+            }
+            frame.dlc = 2 + n;
+            emit(frame, context);
+            frames++;
+        }
+    } else if (format == RAW_FORMAT_PAGES) {
+        const uint8_t header = 6;
+        uint16_t columnsPerFrame = FRAMEBUFFER_MAX_PAYLOAD - header;
+        for (uint16_t page = r.y / 8; page < (r.y + r.h) / 8; page++) {
+            for (uint16_t x = r.x; x < r.x + r.w; x += columnsPerFrame) {
+                uint16_t columns = r.x + r.w - x;
+                if (columns > columnsPerFrame) columns = columnsPerFrame;
+                frame.data[2] = page;
+                frame.data[3] = x & 0xFF;
+                frame.data[4] = x >> 8;
+                frame.data[5] = columns;
+                for (uint16_t c = 0; c < columns; c++) {
+                    uint8_t b = 0;
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        if (getPixel(x + c, page * 8 + bit)) b |= 1 << bit;
+                    }
+                    frame.data[header + c] = b;
+                }
+                frame.dlc = 2 + header + columns;
+                emit(frame, context);
+                frames++;
+            }
+        }
+    } else {
+        const uint8_t header = 7;
+        uint16_t bytesPerColumn = r.h / 8;
+        uint16_t columnsPerFrame = (FRAMEBUFFER_MAX_PAYLOAD - header) / bytesPerColumn;
+        for (uint16_t x = r.x; x < r.x + r.w; x += columnsPerFrame) {
+            uint16_t columns = r.x + r.w - x;
+            if (columns > columnsPerFrame) columns = columnsPerFrame;
+            frame.data[2] = x & 0xFF;
+            frame.data[3] = x >> 8;
+            frame.data[4] = r.y;
+            frame.data[5] = columns;
+            frame.data[6] = r.h;
+            uint16_t n = header;
+            for (uint16_t c = 0; c < columns; c++) {
+                for (uint16_t y = r.y; y < r.y + r.h; y += 8) {
+                    uint8_t b = 0;
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        if (getPixel(x + c, y + bit)) b |= 1 << bit;
+                    }
+                    frame.data[n++] = b;
+                }
+            }
+            frame.dlc = 2 + n;
+            emit(frame, context);
+            frames++;
+        }
+    }
+    return frames;
+}
+
+uint32_t SAAB_HPD_Framebuffer::getFramesSent() {
+    return framesSent;
+}
+
+uint32_t SAAB_HPD_Framebuffer::getBytesSent() {
+    return bytesSent;
+}
+
+// Widens the area to whole bytes: x for the row format, y for the page and column formats
+SAAB_HPD_Framebuffer::Rect SAAB_HPD_Framebuffer::align(const Rect &rect) {
+    Rect r = rect;
+    if (format == RAW_FORMAT_ROWS) {
+        uint16_t x1 = (r.x + r.w + 7) & ~7;
+        r.x &= ~7;
+        r.w = x1 - r.x;
+    } else {
+        uint16_t y1 = (r.y + r.h + 7) & ~7;
+        r.y &= ~7;
+        r.h = y1 - r.y;
+    }
+    return r;
+}
+
+SAAB_HPD_Framebuffer::Rect SAAB_HPD_Framebuffer::unite(const Rect &a, const Rect &b) {
+    uint16_t x0 = a.x < b.x ? a.x : b.x;
+    uint16_t y0 = a.y < b.y ? a.y : b.y;
+    uint16_t x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    uint16_t y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    Rect r = {x0, y0, (uint16_t)(x1 - x0), (uint16_t)(y1 - y0)};
+    return r;
+}
+
+bool SAAB_HPD_Framebuffer::touches(const Rect &a, const Rect &b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+uint32_t SAAB_HPD_Framebuffer::area(const Rect &r) {
+    return (uint32_t)r.w * r.h;
+}
@@ -0,0 +1,78 @@
+#ifndef SAAB_HPD_FRAMEBUFFER_H
+#define SAAB_HPD_FRAMEBUFFER_H
+
+#include <SAAB_HPD.h>
+
+// Green panel resolution
+#define FRAMEBUFFER_WIDTH 384
+#define FRAMEBUFFER_HEIGHT 64
+
+// Dirty rectangles tracked before they are merged
+#define FRAMEBUFFER_MAX_DIRTY 8
+
+// Largest 0x40 payload, DLC 0xFE minus command and padding
+#define FRAMEBUFFER_MAX_PAYLOAD 252
+
+// EXPERIMENTAL: 1 bit per pixel framebuffer for the 384x64 panel, sent with command 0x40.
+// The 0x40 payload format is not known, the encoder supports the candidate layouts below and
+// examples/Probe0x40 tries them against a SID. Only changed areas are sent.
+class SAAB_HPD_Framebuffer {
+public:
+    // Candidate 0x40 payload layouts, header bytes first then pixel data
+    enum RAW_FORMAT {
+        // [region, 0x00, x/8, y, width/8, height] + rows of horizontal bytes, MSB is the left pixel
+        RAW_FORMAT_ROWS,
+        // [region, 0x00, page (y/8), x LSB, x MSB, width] + one byte per column, LSB is the top pixel (SSD1306 style)
+        RAW_FORMAT_PAGES,
+        // [region, 0x00, x LSB, x MSB, y, width, height] + columns of vertical bytes, LSB is the top pixel
+        RAW_FORMAT_COLUMNS
+    };
+
+    struct Rect {
+        uint16_t x;
+        uint16_t y;
+        uint16_t w;
+        uint16_t h;
+    };
+
+    SAAB_HPD_Framebuffer(SAAB_HPD &hpd, uint8_t regionID = 0x02, RAW_FORMAT format = RAW_FORMAT_ROWS);
+
+    void setFormat(RAW_FORMAT format);
+    RAW_FORMAT getFormat();
+
+    // Drawing, every change marks its area dirty
+    void clear(bool on = false);
+    void setPixel(int16_t x, int16_t y, bool on);
+    bool getPixel(int16_t x, int16_t y);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, bool on);
+    void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h); // Rows of horizontal bytes, MSB left
+
+    void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+    uint8_t getDirtyCount();
+    const Rect* getDirty(uint8_t index);
+
+    // Sends the dirty areas, stops at the first error and keeps what was not sent dirty
+    SAAB_HPD::ERROR flush();
+    // Encodes one rectangle into 0x40 frames, calls emit for each, returns the number of frames
+    uint16_t encode(const Rect &rect, void (*emit)(const SAAB_HPD::SerialFrame &frame, void* context), void* context);
+
+    uint32_t getFramesSent();
+    uint32_t getBytesSent();
+
+private:
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    RAW_FORMAT format;
+    uint8_t pixels[FRAMEBUFFER_WIDTH / 8 * FRAMEBUFFER_HEIGHT]; // Rows of horizontal bytes, MSB left
+    Rect dirty[FRAMEBUFFER_MAX_DIRTY];
+    uint8_t dirtyCount;
+    uint32_t framesSent;
+    uint32_t bytesSent;
+
+    Rect align(const Rect &rect);
+    static Rect unite(const Rect &a, const Rect &b);
+    static bool touches(const Rect &a, const Rect &b);
+    static uint32_t area(const Rect &r);
+};
+
+#endif // SAAB_HPD_FRAMEBUFFER_H
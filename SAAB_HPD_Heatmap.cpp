@@ -0,0 +1,155 @@
+#include <SAAB_HPD_Heatmap.h>
+
+// SAAB_HPD_Heatmap class implementation
+
+SAAB_HPD_Heatmap::SAAB_HPD_Heatmap() {
+    reset();
+}
+
+/*!
+  * @brief Count one frame.
+  * @param direction 
+      DIRECTION_RX or DIRECTION_TX.
+  * @param command 
+      Command byte.
+  * @param regionID 
+      Region byte, 0 for frames that do not address a region.
+  * @param subRegion 
+      Sub-region bytes [2:3], 0 for frames that do not address a sub-region.
+  * @param bytes 
+      Wire length of the frame.
+  * @return void
+  
+  * @note Linear probing from the key's home slot, when the table is full the frame is only counted as overflow.
+!*/
+void SAAB_HPD_Heatmap::record(DIRECTION direction, uint8_t command, uint8_t regionID, uint16_t subRegion, uint16_t bytes) {
+    unsigned long now = millis();
+    if (now - windowStart >= HEATMAP_WINDOW_MS) {
+        rollWindow(now);
+    }
+    totalBytes[direction] += bytes;
+
+    uint32_t key = ((uint32_t)command << 24) | ((uint32_t)regionID << 16) | subRegion;
+    uint16_t slot = (uint32_t)((key ^ direction) * 2654435761UL) >> (32 - HEATMAP_BITS); // Fibonacci hashing
+
+    for (uint16_t probe = 0; probe < HEATMAP_SIZE; probe++) {
+        Entry &entry = table[slot];
+        if (!entry.used) {
+            memset(&entry, 0, sizeof(entry));
+            entry.used = true;
+            entry.direction = direction;
+            entry.command = command;
+            entry.regionID = regionID;
+            entry.subRegion = subRegion;
+            keyCount++;
+        }
+        if (entry.direction == direction && entry.command == command && entry.regionID == regionID && entry.subRegion == subRegion) {
+            entry.frames++;
+            entry.bytes += bytes;
+            entry.windowFrames++;
+            entry.windowBytes += bytes;
+            return;
+        }
+        slot = (slot + 1) & (HEATMAP_SIZE - 1);
+    }
+
+    overflowFrames++;
+}
+
+/*!
+  * @brief Get the busiest keys.
+  * @param out 
+      Array receiving up to n entries, highest first.
+  * @param n 
+      Size of out.
+  * @param by 
+      SORT_BY_BYTES, SORT_BY_FRAMES or SORT_BY_BYTES_PER_SECOND.
+  * @return The number of entries written.
+!*/
+size_t SAAB_HPD_Heatmap::top(Entry* out, size_t n, SORT_BY by) {
+    if (millis() - windowStart >= HEATMAP_WINDOW_MS) {
+        rollWindow(millis());
+    }
+
+    // Insertion into the short output list, n is small compared to the table
+    size_t found = 0;
+    for (uint16_t i = 0; i < HEATMAP_SIZE; i++) {
+        if (!table[i].used) continue;
+        uint32_t value = sortValue(table[i], by);
+
+        size_t pos = found;
+        while (pos > 0 && sortValue(out[pos - 1], by) < value) {
+            if (pos < n) out[pos] = out[pos - 1];
+            pos--;
+        }
+        if (pos < n) {
+            out[pos] = table[i];
+            if (found < n) found++;
+        }
+    }
+    return found;
+}
+
+void SAAB_HPD_Heatmap::printTop(Print &out, size_t n, SORT_BY by) {
+    Entry entries[16];
+    if (n > 16) n = 16;
+    size_t count = top(entries, n, by);
+
+    out.printf("\n--- Bus heatmap, top %u of %u keys ---\n", (unsigned)count, keyCount);
+    out.println("DIR CMD  REG  SUB       FRAMES      BYTES  FRAMES/S  BYTES/S   SHARE");
+    for (size_t i = 0; i < count; i++) {
+        const Entry &e = entries[i];
+        uint32_t total = totalBytes[e.direction];
+        out.printf("%s  0x%02X 0x%02X 0x%04X %9u %10u %9u %8u %6.1f%%\n",
+                   e.direction == DIRECTION_TX ? "TX" : "RX", e.command, e.regionID, e.subRegion,
+                   (unsigned)e.frames, (unsigned)e.bytes, e.framesPerSecond, e.bytesPerSecond,
+                   total ? 100.0f * e.bytes / total : 0.0f);
+    }
+    if (overflowFrames) {
+        out.printf("Untracked frames (table full): %u\n", (unsigned)overflowFrames);
+    }
+    out.println("--------------------------------------");
+}
+
+uint16_t SAAB_HPD_Heatmap::getKeyCount() {
+    return keyCount;
+}
+
+uint32_t SAAB_HPD_Heatmap::getOverflowFrames() {
+    return overflowFrames;
+}
+
+uint32_t SAAB_HPD_Heatmap::getTotalBytes(DIRECTION direction) {
+    return totalBytes[direction];
+}
+
+void SAAB_HPD_Heatmap::reset() {
+    memset(table, 0, sizeof(table));
+    keyCount = 0;
+    overflowFrames = 0;
+    totalBytes[DIRECTION_RX] = 0;
+    totalBytes[DIRECTION_TX] = 0;
+    windowStart = millis();
+}
+
+void SAAB_HPD_Heatmap::rollWindow(unsigned long now) {
+    // An idle gap longer than one window reads as zero
+    bool idleGap = now - windowStart >= 2 * HEATMAP_WINDOW_MS;
+    for (uint16_t i = 0; i < HEATMAP_SIZE; i++) {
+        Entry &entry = table[i];
+        if (!entry.used) continue;
+        entry.framesPerSecond = idleGap ? 0 : entry.windowFrames;
+        entry.bytesPerSecond = idleGap ? 0 : entry.windowBytes;
+        entry.windowFrames = 0;
+        entry.windowBytes = 0;
+    }
+    windowStart = now;
+}
+
+uint32_t SAAB_HPD_Heatmap::sortValue(const Entry &entry, SORT_BY by) {
+    switch (by) {
+        case SORT_BY_FRAMES: return entry.frames;
+        case SORT_BY_BYTES_PER_SECOND: return entry.bytesPerSecond;
+        default: return entry.bytes;
+    }
+}
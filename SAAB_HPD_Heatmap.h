@@ -0,0 +1,64 @@
+#ifndef SAAB_HPD_HEATMAP_H
+#define SAAB_HPD_HEATMAP_H
+
+#include <Arduino.h>
+
+// Number of (direction, command, region, sub-region) keys tracked, must be a power of two
+#define HEATMAP_BITS 7
+#define HEATMAP_SIZE (1 << HEATMAP_BITS)
+
+// Length of the window the per second rates are taken over
+#define HEATMAP_WINDOW_MS 1000
+
+// Per sub-region traffic counters for both directions, in an open addressed hash table.
+class SAAB_HPD_Heatmap {
+public:
+    enum DIRECTION {
+        DIRECTION_RX = 0, // ICM and SID frames seen on the line
+        DIRECTION_TX = 1  // Our frames
+    };
+
+    enum SORT_BY {
+        SORT_BY_BYTES,            // Total bytes
+        SORT_BY_FRAMES,           // Total frames
+        SORT_BY_BYTES_PER_SECOND  // Bytes in the last complete window
+    };
+
+    struct Entry {
+        uint8_t direction;
+        uint8_t command;
+        uint8_t regionID;
+        uint16_t subRegion;       // Sub-region bytes [2:3] for region frames, 0 otherwise
+        uint32_t frames;
+        uint32_t bytes;           // Wire bytes, DLC + 2
+        uint16_t framesPerSecond; // Last complete window
+        uint16_t bytesPerSecond;
+        uint16_t windowFrames;    // Current window
+        uint16_t windowBytes;
+        bool used;
+    };
+
+    SAAB_HPD_Heatmap();
+
+    void record(DIRECTION direction, uint8_t command, uint8_t regionID, uint16_t subRegion, uint16_t bytes);
+
+    size_t top(Entry* out, size_t n, SORT_BY by = SORT_BY_BYTES); // Highest first, returns the number written
+    void printTop(Print &out = Serial, size_t n = 10, SORT_BY by = SORT_BY_BYTES);
+
+    uint16_t getKeyCount();
+    uint32_t getOverflowFrames(); // Frames not tracked because the table was full
+    uint32_t getTotalBytes(DIRECTION direction);
+    void reset();
+
+private:
+    Entry table[HEATMAP_SIZE];
+    uint16_t keyCount;
+    uint32_t overflowFrames;
+    uint32_t totalBytes[2];
+    unsigned long windowStart;
+
+    void rollWindow(unsigned long now);
+    static uint32_t sortValue(const Entry &entry, SORT_BY by);
+};
+
+#endif // SAAB_HPD_HEATMAP_H
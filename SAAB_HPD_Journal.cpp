@@ -0,0 +1,274 @@
+#include <SAAB_HPD_Journal.h>
+
+// SAAB_HPD_Journal class implementation
+
+SAAB_HPD_Journal::SAAB_HPD_Journal(size_t storageBytes, uint16_t maxRecords)
+    : storage(nullptr), storageSize(storageBytes), writePos(0), psram(false),
+      records(nullptr), links(nullptr), recordCapacity(maxRecords), recordHead(0), recordCount(0), recordTotal(0),
+      dumpOnError(false), dumpOut(&Serial), lastDump(0), dumped(false), dumpDue(false) {}
+
+SAAB_HPD_Journal::~SAAB_HPD_Journal() {
+    free(storage);
+    free(records);
+    free(links);
+}
+
+/*!
+  * @brief Allocate the byte store and the record index.
+  * @return true on success, false if out of memory.
+  
+  * @note On ESP32 boards with PSRAM the byte store is placed there, the index stays in internal RAM.
+!*/
+bool SAAB_HPD_Journal::begin() {
+    if (storage != nullptr) {
+        return true;
+    }
+
+#if defined(ESP32)
+    if (psramFound()) {
+        storage = static_cast<uint8_t*>(ps_malloc(storageSize));
+        psram = storage != nullptr;
+    }
+#endif
+    if (storage == nullptr) {
+        storage = static_cast<uint8_t*>(malloc(storageSize));
+    }
+    records = static_cast<Record*>(malloc(recordCapacity * sizeof(Record)));
+    links = static_cast<Links*>(malloc(recordCapacity * sizeof(Links)));
+
+    if (storage == nullptr || records == nullptr || links == nullptr) {
+        free(storage);
+        free(records);
+        free(links);
+        storage = nullptr;
+        records = nullptr;
+        links = nullptr;
+        return false;
+    }
+    clear();
+    return true;
+}
+
+bool SAAB_HPD_Journal::usesPsram() {
+    return psram;
+}
+
+/*!
+  * @brief Append a frame to the journal.
+  * @param direction 
+      DIRECTION_RX or DIRECTION_TX.
+  * @param wire 
+      The frame as it appears on the line (DLC, command, padding, data, checksum).
+  * @param len 
+      Number of bytes.
+  * @return void
+  
+  * @note The oldest records are dropped when their bytes get overwritten or the record ring is full.
+!*/
+void SAAB_HPD_Journal::record(DIRECTION direction, const uint8_t* wire, size_t len) {
+    if (storage == nullptr || len == 0 || len > storageSize || len > JOURNAL_MAX_FRAME_BYTES) {
+        return;
+    }
+
+    Record &r = records[recordHead];
+    r.timestamp = millis();
+    r.offset = writePos;
+    r.direction = direction;
+    r.length = len;
+    r.command = len > 1 ? wire[1] : 0x00;
+    r.regionID = len > 3 ? wire[3] : 0x00;
+    r.subRegion = len > 6 ? (wire[5] << 8) | wire[6] : 0x0000;
+
+    // Copy in at most two pieces around the end of the store
+    size_t start = writePos % storageSize;
+    size_t first = storageSize - start;
+    if (first > len) first = len;
+    memcpy(&storage[start], wire, first);
+    memcpy(storage, &wire[first], len - first);
+    writePos += len;
+
+    // Chain the record behind the previous one with the same command and sub-region
+    Links &l = links[recordHead];
+    l.previousCommand = commandHeads[r.command];
+    commandHeads[r.command] = recordTotal + 1;
+    l.previousSubRegion = 0;
+    if (isRegionFrame(r.command)) {
+        uint8_t bucket = subRegionBucket(r.regionID, r.subRegion);
+        l.previousSubRegion = subRegionHeads[bucket];
+        subRegionHeads[bucket] = recordTotal + 1;
+    }
+    recordTotal++;
+
+    recordHead = (recordHead + 1) % recordCapacity;
+    if (recordCount < recordCapacity) recordCount++;
+    dropOverwritten();
+}
+
+void SAAB_HPD_Journal::clear() {
+    writePos = 0;
+    recordHead = 0;
+    recordCount = 0;
+    recordTotal = 0;
+    memset(commandHeads, 0, sizeof(commandHeads));
+    memset(subRegionHeads, 0, sizeof(subRegionHeads));
+}
+
+size_t SAAB_HPD_Journal::last(Record* out, size_t n) {
+    size_t found = 0;
+    for (uint16_t age = 0; age < recordCount && found < n; age++) {
+        out[found++] = recordAt(age);
+    }
+    return found;
+}
+
+size_t SAAB_HPD_Journal::lastByCommand(uint8_t command, Record* out, size_t n) {
+    size_t found = 0;
+    for (uint32_t link = commandHeads[command]; link != 0 && found < n && isHeld(link - 1);) {
+        uint16_t slot = (link - 1) % recordCapacity;
+        out[found++] = records[slot];
+        link = links[slot].previousCommand;
+    }
+    return found;
+}
+
+size_t SAAB_HPD_Journal::lastBySubRegion(uint8_t regionID, uint16_t subRegion, Record* out, size_t n) {
+    // The bucket chain is shared with other sub-regions of the same hash
+    size_t found = 0;
+    for (uint32_t link = subRegionHeads[subRegionBucket(regionID, subRegion)]; link != 0 && found < n && isHeld(link - 1);) {
+        uint16_t slot = (link - 1) % recordCapacity;
+        const Record &r = records[slot];
+        if (r.regionID == regionID && r.subRegion == subRegion) out[found++] = r;
+        link = links[slot].previousSubRegion;
+    }
+    return found;
+}
+
+size_t SAAB_HPD_Journal::since(uint32_t since, Record* out, size_t n) {
+    // Timestamps only grow, binary search for the number of records at or after since
+    uint16_t low = 0;
+    uint16_t high = recordCount;
+    while (low < high) {
+        uint16_t mid = low + (high - low) / 2;
+        if ((int32_t)(recordAt(mid).timestamp - since) >= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    uint16_t inRange = low;
+
+    size_t found = 0;
+    for (uint16_t age = inRange; age > 0 && found < n; age--) {
+        out[found++] = recordAt(age - 1);
+    }
+    return found;
+}
+
+size_t SAAB_HPD_Journal::readBytes(const Record &record, uint8_t* out) {
+    if (storage == nullptr || !isValid(record)) {
+        return 0;
+    }
+
+    size_t start = record.offset % storageSize;
+    size_t first = storageSize - start;
+    if (first > record.length) first = record.length;
+    memcpy(out, &storage[start], first);
+    memcpy(&out[first], storage, record.length - first);
+    return record.length;
+}
+
+uint16_t SAAB_HPD_Journal::getRecordCount() {
+    return recordCount;
+}
+
+/*!
+  * @brief Print the journal, oldest record first.
+  * @param out 
+      Where to print, Serial by default.
+  * @param lastN 
+      Only print the newest lastN records, 0 prints all of them.
+  * @return void
+!*/
+void SAAB_HPD_Journal::dump(Print &out, size_t lastN) {
+    uint16_t count = recordCount;
+    if (lastN != 0 && lastN < count) count = lastN;
+
+    out.printf("\n--- Frame journal (%u records, %u bytes%s) ---\n", count, (unsigned)storageSize, psram ? ", PSRAM" : "");
+    for (uint16_t age = count; age > 0; age--) {
+        printRecord(out, recordAt(age - 1));
+    }
+    out.println("-------------------------------------");
+}
+
+/*!
+  * @brief Dump the journal automatically when the driver sees an error.
+  * @param enable 
+      true to dump on NACK, ACK timeout and sync loss.
+  * @param out 
+      Where to print, Serial by default.
+  * @return void
+  
+  * @note At most one dump per JOURNAL_DUMP_INTERVAL_MS, so a burst of errors prints the journal once.
+  * @note The dump is printed from the next SAAB_HPD::poll(), printing from the RX/TX path would overrun the UART RX FIFO.
+!*/
+void SAAB_HPD_Journal::setDumpOnError(bool enable, Print &out) {
+    dumpOnError = enable;
+    dumpOut = &out;
+}
+
+void SAAB_HPD_Journal::notifyError() {
+    if (!dumpOnError || storage == nullptr) {
+        return;
+    }
+    if (dumped && millis() - lastDump < JOURNAL_DUMP_INTERVAL_MS) {
+        return;
+    }
+    dumped = true;
+    lastDump = millis();
+    dumpDue = true;
+}
+
+void SAAB_HPD_Journal::poll() {
+    if (dumpDue) {
+        dumpDue = false;
+        dump(*dumpOut);
+    }
+}
+
+const SAAB_HPD_Journal::Record &SAAB_HPD_Journal::recordAt(uint16_t age) {
+    return records[(recordHead + recordCapacity - 1 - age) % recordCapacity];
+}
+
+bool SAAB_HPD_Journal::isHeld(uint32_t sequence) {
+    return recordTotal - sequence <= recordCount;
+}
+
+bool SAAB_HPD_Journal::isRegionFrame(uint8_t command) {
+    return command == 0x10 || command == 0x11 || command == 0x30 || command == 0x33;
+}
+
+uint8_t SAAB_HPD_Journal::subRegionBucket(uint8_t regionID, uint16_t subRegion) {
+    uint32_t key = ((uint32_t)regionID << 16) | subRegion;
+    return ((uint32_t)(key * 2654435761UL) >> 24) & (JOURNAL_SUBREGION_BUCKETS - 1);
+}
+
+bool SAAB_HPD_Journal::isValid(const Record &record) {
+    return writePos - record.offset <= storageSize;
+}
+
+void SAAB_HPD_Journal::dropOverwritten() {
+    while (recordCount > 0 && !isValid(recordAt(recordCount - 1))) {
+        recordCount--;
+    }
+}
+
+void SAAB_HPD_Journal::printRecord(Print &out, const Record &record) {
+    uint8_t bytes[JOURNAL_MAX_FRAME_BYTES];
+    size_t len = readBytes(record, bytes);
+
+    out.printf("%10lu %s:", (unsigned long)record.timestamp, record.direction == DIRECTION_TX ? "TX" : "RX");
+    for (size_t i = 0; i < len; i++) {
+        out.printf(" %02X", bytes[i]);
+    }
+    out.println();
+}
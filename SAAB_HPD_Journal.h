@@ -0,0 +1,102 @@
+#ifndef SAAB_HPD_JOURNAL_H
+#define SAAB_HPD_JOURNAL_H
+
+#include <Arduino.h>
+
+// Default size of the byte store, frames are stored as they appear on the wire
+#define JOURNAL_DEFAULT_BYTES 8192
+
+// Default number of indexed records
+#define JOURNAL_DEFAULT_RECORDS 512
+
+// Errors closer together than this only dump the journal once
+#define JOURNAL_DUMP_INTERVAL_MS 1000
+
+// Largest frame on the wire, BUFFER_SIZE + 2
+#define JOURNAL_MAX_FRAME_BYTES 0x101
+
+// Hash buckets of the sub-region index, must be a power of two
+#define JOURNAL_SUBREGION_BUCKETS 64
+
+// Circular journal of recent RX/TX frames.
+// Frame bytes go into one byte ring (PSRAM when present), a separate record ring holds timestamp,
+// direction, command and sub-region per record. Records are chained per command and per sub-region,
+// so the filtered queries only visit matching records.
+class SAAB_HPD_Journal {
+public:
+    enum DIRECTION {
+        DIRECTION_RX = 0, // Received from the line
+        DIRECTION_TX = 1  // Sent by us
+    };
+
+    struct Record {
+        uint32_t timestamp; // millis()
+        uint32_t offset;    // Position in the byte store
+        uint8_t direction;
+        uint16_t length;    // Wire bytes, DLC + 2 (+ padding)
+        uint8_t command;
+        uint8_t regionID;
+        uint16_t subRegion; // Sub-region bytes [2:3] for region frames, 0 otherwise
+    };
+
+    SAAB_HPD_Journal(size_t storageBytes = JOURNAL_DEFAULT_BYTES, uint16_t maxRecords = JOURNAL_DEFAULT_RECORDS);
+    ~SAAB_HPD_Journal();
+
+    bool begin(); // Allocates the store, false if out of memory
+    bool usesPsram();
+
+    void record(DIRECTION direction, const uint8_t* wire, size_t len); // Wire bytes as sent or received
+    void clear();
+
+    // Queries, newest first, return the number of records written to out
+    size_t last(Record* out, size_t n);
+    size_t lastByCommand(uint8_t command, Record* out, size_t n);
+    size_t lastBySubRegion(uint8_t regionID, uint16_t subRegion, Record* out, size_t n);
+    // Records with timestamp >= since, oldest first, binary search on the timestamps
+    size_t since(uint32_t since, Record* out, size_t n);
+
+    size_t readBytes(const Record &record, uint8_t* out); // Copies the wire bytes, returns the length (0 if overwritten)
+    uint16_t getRecordCount();
+
+    void dump(Print &out = Serial, size_t lastN = 0); // 0 dumps everything held
+    void setDumpOnError(bool enable, Print &out = Serial);
+    void notifyError(); // Called by SAAB_HPD on NACK, timeout and sync loss, only marks a dump as due
+    void poll(); // Prints a due dump, called from SAAB_HPD::poll() outside the RX/TX path
+
+private:
+    uint8_t* storage;
+    size_t storageSize;
+    uint32_t writePos; // Total bytes written, position in storage is writePos % storageSize
+    bool psram;
+
+    // Previous record with the same command / in the same sub-region bucket, as sequence number + 1, 0 for none
+    struct Links {
+        uint32_t previousCommand;
+        uint32_t previousSubRegion;
+    };
+
+    Record* records;
+    Links* links; // Parallel to records
+    uint16_t recordCapacity;
+    uint16_t recordHead; // Next index slot to write
+    uint16_t recordCount;
+    uint32_t recordTotal; // Sequence number of the next record
+    uint32_t commandHeads[256]; // Newest record per command, sequence number + 1
+    uint32_t subRegionHeads[JOURNAL_SUBREGION_BUCKETS];
+
+    bool dumpOnError;
+    Print* dumpOut;
+    unsigned long lastDump;
+    bool dumped; // A dump happened at least once
+    bool dumpDue;
+
+    const Record &recordAt(uint16_t age); // 0 is the newest
+    bool isHeld(uint32_t sequence);
+    static bool isRegionFrame(uint8_t command);
+    static uint8_t subRegionBucket(uint8_t regionID, uint16_t subRegion);
+    bool isValid(const Record &record);
+    void dropOverwritten();
+    void printRecord(Print &out, const Record &record);
+};
+
+#endif // SAAB_HPD_JOURNAL_H
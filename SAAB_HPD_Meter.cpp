@@ -0,0 +1,160 @@
+#include <SAAB_HPD_Meter.h>
+
+// SAAB_HPD_Meter class implementation
+
+SAAB_HPD_Meter::SAAB_HPD_Meter(SAAB_HPD &hpd, uint8_t regionID, uint8_t subRegionID)
+    : hpd(hpd), regionID(regionID), subRegionID(subRegionID), steps(16), fullScale(255), filledGlyph('|'), emptyGlyph(' '),
+      budget(10, 2), shownSteps(0xFF), sentSteps(0xFE), targetSteps(0), pending(false), wakeTimer(0),
+      sender(hpd, fillFrame, onDone, this),
+      framesSent(0), droppedUpdates(0), unchangedUpdates(0) {
+}
+
+/*!
+  * @brief Create the meter sub-region with an empty bar.
+  * @param xPos 
+      Left edge of the bar.
+  * @param yPos 
+      Baseline of the bar.
+  * @param width 
+      Width of the sub-region in pixels.
+  * @param steps 
+      Characters in the bar, at most METER_MAX_STEPS.
+  * @param fontStyle 
+      Font of the bar characters.
+  * @return ERROR_OK, or the error of the makeRegion frame.
+  
+  * @note Blocks for the ACK, call it once while setting up the screen.
+!*/
+SAAB_HPD::ERROR SAAB_HPD_Meter::begin(uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t steps, uint8_t fontStyle) {
+    if (steps == 0) steps = 1;
+    if (steps > METER_MAX_STEPS) steps = METER_MAX_STEPS;
+    this->steps = steps;
+
+    char text[METER_MAX_STEPS + 1];
+    memset(text, emptyGlyph, steps);
+    text[steps] = '\0';
+    SAAB_HPD::ERROR result = hpd.makeRegion(regionID, 0x02, subRegionID, xPos, yPos, width, fontStyle, text);
+    if (result == SAAB_HPD::ERROR_OK) {
+        shownSteps = 0;
+        sentSteps = 0;
+        framesSent++;
+    }
+    budget.fill(hpd.getTimers().now());
+    pending = false;
+    return result;
+}
+
+void SAAB_HPD_Meter::setBudget(uint8_t framesPerSecond, uint8_t burst) {
+    budget.setRate(framesPerSecond, burst, hpd.getTimers().now());
+}
+
+void SAAB_HPD_Meter::setRange(uint16_t fullScale) {
+    this->fullScale = fullScale ? fullScale : 1;
+}
+
+void SAAB_HPD_Meter::setGlyphs(char filled, char empty) {
+    filledGlyph = filled;
+    emptyGlyph = empty;
+}
+
+/*!
+  * @brief Report a new level, as often as the source produces them.
+  * @param value 
+      0 to the full scale set with setRange().
+  * @return void
+  
+  * @note Costs a frame only when the quantized level changed and the budget allows it, otherwise the level waits and a newer one replaces it.
+!*/
+void SAAB_HPD_Meter::setLevel(uint16_t value) {
+    if (shownSteps == 0xFF) {
+        return; // begin() did not create the sub-region
+    }
+    if (value > fullScale) value = fullScale;
+    uint8_t next = ((uint32_t)value * steps + fullScale / 2) / fullScale;
+
+    if (pending) {
+        if (next == targetSteps) {
+            unchangedUpdates++;
+            return;
+        }
+        droppedUpdates++; // The waiting level is stale now
+        if (next == sentSteps) {
+            pending = false; // Back to what the SID shows
+            return;
+        }
+    } else if (next == sentSteps) {
+        unchangedUpdates++;
+        return;
+    }
+
+    targetSteps = next;
+    pending = true;
+    sender.send();
+}
+
+uint8_t SAAB_HPD_Meter::getShownSteps() {
+    return shownSteps;
+}
+
+uint32_t SAAB_HPD_Meter::getFramesSent() {
+    return framesSent;
+}
+
+uint32_t SAAB_HPD_Meter::getDroppedUpdates() {
+    return droppedUpdates;
+}
+
+uint32_t SAAB_HPD_Meter::getUnchangedUpdates() {
+    return unchangedUpdates;
+}
+
+// Builds the frame of the waiting level if the budget allows it, otherwise wakes up when it will
+bool SAAB_HPD_Meter::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_Meter* meter = static_cast<SAAB_HPD_Meter*>(context);
+    if (!meter->pending) {
+        return false;
+    }
+    SAAB_HPD_Timer &timers = meter->hpd.getTimers();
+    if (timers.isScheduled(meter->wakeTimer)) {
+        return false; // Already waiting, the newest level goes out on wake up
+    }
+
+    uint32_t wait = meter->budget.wait(timers.now());
+    if (wait > 0) {
+        meter->wakeTimer = timers.schedule(wait, onWake, meter);
+        return false;
+    }
+
+    uint8_t steps = meter->targetSteps;
+    char text[METER_MAX_STEPS + 1];
+    memset(text, meter->filledGlyph, steps);
+    memset(text + steps, meter->emptyGlyph, meter->steps - steps);
+    text[meter->steps] = '\0';
+    SAAB_HPD::buildChangeRegion(frame, meter->regionID, 0x02, meter->subRegionID, HPD_VISIBLE, HPD_STYLE_NORMAL, text);
+
+    meter->budget.take();
+    meter->sentSteps = steps;
+    meter->pending = false;
+    meter->framesSent++;
+    return true;
+}
+
+// A level only counts as shown once the SID acknowledged it, a failed one is sent again unless a newer one waits
+void SAAB_HPD_Meter::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Meter* meter = static_cast<SAAB_HPD_Meter*>(context);
+    if (result == SAAB_HPD::ERROR_OK) {
+        meter->shownSteps = meter->sentSteps;
+        return;
+    }
+    if (!meter->pending) {
+        meter->targetSteps = meter->sentSteps;
+        meter->pending = true;
+    }
+    meter->sentSteps = 0xFE;
+}
+
+void SAAB_HPD_Meter::onWake(void* context) {
+    SAAB_HPD_Meter* meter = static_cast<SAAB_HPD_Meter*>(context);
+    meter->wakeTimer = 0;
+    meter->sender.send();
+}
@@ -0,0 +1,58 @@
+#ifndef SAAB_HPD_METER_H
+#define SAAB_HPD_METER_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+#include <SAAB_HPD_TokenBucket.h>
+
+// Longest bar in characters
+#define METER_MAX_STEPS 32
+
+// Level meter drawn as a bar of characters in one sub-region.
+// Levels are quantized to the bar steps and only a changed step count is sent. A token bucket limits
+// the frames per second, while it is empty (or a frame is in flight) only the newest level is kept
+// and the older ones are dropped, so the bus load stays within the budget at any input rate.
+class SAAB_HPD_Meter {
+public:
+    SAAB_HPD_Meter(SAAB_HPD &hpd, uint8_t regionID = 0x01, uint8_t subRegionID = 0xC8);
+
+    SAAB_HPD::ERROR begin(uint16_t xPos, uint8_t yPos, uint8_t width, uint8_t steps = 16, uint8_t fontStyle = HPD_FONT_SMALL);
+    void setBudget(uint8_t framesPerSecond, uint8_t burst = 2); // 10 frames per second and a burst of 2 by default
+    void setRange(uint16_t fullScale); // Input value of a full bar, 255 by default
+    void setGlyphs(char filled, char empty);
+
+    void setLevel(uint16_t value);
+    uint8_t getShownSteps(); // Steps acknowledged by the SID
+
+    uint32_t getFramesSent();
+    uint32_t getDroppedUpdates(); // Levels replaced by a newer one before they could be sent
+    uint32_t getUnchangedUpdates(); // Levels that quantized to what was already on its way
+
+private:
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    uint8_t subRegionID;
+    uint8_t steps;
+    uint16_t fullScale;
+    char filledGlyph;
+    char emptyGlyph;
+
+    SAAB_HPD_TokenBucket budget;
+
+    uint8_t shownSteps; // 0xFF until begin()
+    uint8_t sentSteps; // Steps on the SID once the frame in flight is answered, 0xFE when unknown
+    uint8_t targetSteps;
+    bool pending;
+    SAAB_HPD_Timer::TimerId wakeTimer;
+    SAAB_HPD_Sender sender;
+
+    uint32_t framesSent;
+    uint32_t droppedUpdates;
+    uint32_t unchangedUpdates;
+
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+    static void onWake(void* context);
+};
+
+#endif // SAAB_HPD_METER_H
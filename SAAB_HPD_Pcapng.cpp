@@ -0,0 +1,179 @@
+#include <SAAB_HPD_Pcapng.h>
+
+// SAAB_HPD_Pcapng class implementation
+
+// pcapng block types and options
+#define PCAPNG_SECTION_HEADER 0x0A0D0D0A
+#define PCAPNG_INTERFACE_DESCRIPTION 0x00000001
+#define PCAPNG_ENHANCED_PACKET 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_EPB_FLAGS 2
+
+// Block type, length, interface, timestamp (2), captured and original length, trailing length
+#define PCAPNG_EPB_FIXED 32
+// epb_flags (4 + 4) and end of options (4)
+#define PCAPNG_EPB_OPTIONS 12
+
+SAAB_HPD_Pcapng::SAAB_HPD_Pcapng()
+    : out(nullptr), bufferUsed(0), packets(0), bytesWritten(0), epochOffset(0), lastMicros(0), microsHigh(0) {}
+
+/*!
+  * @brief Start a capture.
+  * @param out 
+      Where the pcapng stream is written.
+  * @param epochOffsetMicros 
+      Added to micros() for packet timestamps, pass the Unix time in microseconds at boot for wall clock times.
+  * @return void
+  
+  * @note Writes a section header and one interface (LINKTYPE_USER0, microsecond resolution) for the SID line.
+!*/
+void SAAB_HPD_Pcapng::begin(Print &out, uint64_t epochOffsetMicros) {
+    this->out = &out;
+    bufferUsed = 0;
+    packets = 0;
+    bytesWritten = 0;
+    epochOffset = epochOffsetMicros;
+    lastMicros = micros();
+    microsHigh = 0;
+
+    // Section header block, no options, section length unknown
+    put32(PCAPNG_SECTION_HEADER);
+    put32(28);
+    put32(PCAPNG_BYTE_ORDER_MAGIC);
+    put16(1); // Major version
+    put16(0); // Minor version
+    put32(0xFFFFFFFF);
+    put32(0xFFFFFFFF);
+    put32(28);
+
+    // Interface description block with if_name, timestamps default to microseconds
+    static const char name[] = "SID HPD UART"; // 12 bytes, no padding needed
+    const uint32_t idbLength = 20 + 4 + 12 + 4;
+    put32(PCAPNG_INTERFACE_DESCRIPTION);
+    put32(idbLength);
+    put16(PCAPNG_LINKTYPE_SID);
+    put16(0); // Reserved
+    put32(0); // No snap length limit
+    put16(PCAPNG_OPT_IF_NAME);
+    put16(12);
+    put(name, 12);
+    put16(PCAPNG_OPT_END);
+    put16(0);
+    put32(idbLength);
+}
+
+void SAAB_HPD_Pcapng::end() {
+    flush();
+    out = nullptr;
+}
+
+/*!
+  * @brief Write one frame as a packet.
+  * @param direction 
+      DIRECTION_RX or DIRECTION_TX.
+  * @param frame 
+      The frame, DLC and checksum as received or sent.
+  * @return void
+  
+  * @note The wire bytes go straight from the frame fields into the output buffer, no intermediate copy.
+!*/
+void SAAB_HPD_Pcapng::writeFrame(DIRECTION direction, const SAAB_HPD::SerialFrame &frame) {
+    if (out == nullptr) return;
+
+    size_t dataLength = frame.dlc > 2 ? frame.dlc - 2 : 0;
+    size_t len = 2 + (frame.dlc >= 2 ? 1 : 0) + dataLength + 1;
+    beginPacket(len);
+    put8(frame.dlc);
+    put8(frame.command);
+    if (frame.dlc >= 2) put8(0x00); // Padding byte
+    put(frame.data, dataLength);
+    put8(frame.checksum);
+    endPacket(direction, len);
+}
+
+void SAAB_HPD_Pcapng::writeWire(DIRECTION direction, const uint8_t* wire, size_t len) {
+    if (out == nullptr) return;
+
+    beginPacket(len);
+    put(wire, len);
+    endPacket(direction, len);
+}
+
+void SAAB_HPD_Pcapng::flush() {
+    if (out && bufferUsed) {
+        out->write(buffer, bufferUsed);
+        bytesWritten += bufferUsed;
+    }
+    bufferUsed = 0;
+}
+
+uint32_t SAAB_HPD_Pcapng::getPacketCount() {
+    return packets;
+}
+
+uint32_t SAAB_HPD_Pcapng::getBytesWritten() {
+    return bytesWritten + bufferUsed;
+}
+
+uint64_t SAAB_HPD_Pcapng::timestamp() {
+    uint32_t now = micros();
+    if (now < lastMicros) microsHigh++;
+    lastMicros = now;
+    return epochOffset + (((uint64_t)microsHigh << 32) | now);
+}
+
+void SAAB_HPD_Pcapng::beginPacket(size_t len) {
+    size_t padded = (len + 3) & ~3;
+    uint32_t blockLength = PCAPNG_EPB_FIXED + padded + PCAPNG_EPB_OPTIONS;
+    uint64_t ts = timestamp();
+
+    put32(PCAPNG_ENHANCED_PACKET);
+    put32(blockLength);
+    put32(0); // Interface 0
+    put32(ts >> 32);
+    put32(ts & 0xFFFFFFFF);
+    put32(len); // Captured length
+    put32(len); // Original length
+}
+
+void SAAB_HPD_Pcapng::endPacket(DIRECTION direction, size_t len) {
+    static const uint8_t zeros[3] = {0, 0, 0};
+    size_t padded = (len + 3) & ~3;
+    put(zeros, padded - len);
+
+    put16(PCAPNG_OPT_EPB_FLAGS);
+    put16(4);
+    put32(direction); // Bits 0-1: 01 inbound, 10 outbound
+    put16(PCAPNG_OPT_END);
+    put16(0);
+    put32(PCAPNG_EPB_FIXED + padded + PCAPNG_EPB_OPTIONS);
+    packets++;
+}
+
+void SAAB_HPD_Pcapng::put(const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        if (bufferUsed == PCAPNG_BUFFER_SIZE) flush();
+        size_t chunk = PCAPNG_BUFFER_SIZE - bufferUsed;
+        if (chunk > len) chunk = len;
+        memcpy(&buffer[bufferUsed], bytes, chunk);
+        bufferUsed += chunk;
+        bytes += chunk;
+        len -= chunk;
+    }
+}
+
+// pcapng is written in the host byte order, the byte order magic tells readers which one (little endian on ESP32)
+void SAAB_HPD_Pcapng::put8(uint8_t value) {
+    put(&value, 1);
+}
+
+void SAAB_HPD_Pcapng::put16(uint16_t value) {
+    put(&value, 2);
+}
+
+void SAAB_HPD_Pcapng::put32(uint32_t value) {
+    put(&value, 4);
+}
@@ -0,0 +1,54 @@
+#ifndef SAAB_HPD_PCAPNG_H
+#define SAAB_HPD_PCAPNG_H
+
+#include <SAAB_HPD.h>
+
+// LINKTYPE_USER0, the dissector in tools/sid_hpd.lua registers on it
+#define PCAPNG_LINKTYPE_SID 147
+
+// Bytes collected before they are written to the output
+#define PCAPNG_BUFFER_SIZE 1024
+
+// Streams SID frames into a pcapng file, one packet per frame with direction flags and microsecond timestamps.
+// The output can be any Print: an SD card File, a TCP client, a spare UART.
+class SAAB_HPD_Pcapng {
+public:
+    enum DIRECTION {
+        DIRECTION_RX = 1, // epb_flags inbound
+        DIRECTION_TX = 2  // epb_flags outbound
+    };
+
+    SAAB_HPD_Pcapng();
+
+    void begin(Print &out, uint64_t epochOffsetMicros = 0); // Writes the section and interface headers
+    void end(); // Flushes and detaches the output
+
+    void writeFrame(DIRECTION direction, const SAAB_HPD::SerialFrame &frame); // Wire bytes are produced from the frame fields
+    void writeWire(DIRECTION direction, const uint8_t* wire, size_t len);
+    void flush();
+
+    uint32_t getPacketCount();
+    uint32_t getBytesWritten();
+
+private:
+    Print* out;
+    uint8_t buffer[PCAPNG_BUFFER_SIZE];
+    size_t bufferUsed;
+    uint32_t packets;
+    uint32_t bytesWritten;
+
+    // micros() extended to 64 bits, it wraps after about 71 minutes
+    uint64_t epochOffset;
+    uint32_t lastMicros;
+    uint32_t microsHigh;
+
+    uint64_t timestamp();
+    void beginPacket(size_t len);
+    void endPacket(DIRECTION direction, size_t len);
+    void put(const void* data, size_t len);
+    void put8(uint8_t value);
+    void put16(uint16_t value);
+    void put32(uint32_t value);
+};
+
+#endif // SAAB_HPD_PCAPNG_H
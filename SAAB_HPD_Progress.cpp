@@ -0,0 +1,165 @@
+#include <SAAB_HPD_Progress.h>
+
+// SAAB_HPD_Progress class implementation
+
+SAAB_HPD_Progress::SAAB_HPD_Progress(SAAB_HPD &hpd, uint8_t regionID, uint8_t firstSubRegion)
+    : hpd(hpd), regionID(regionID), firstSubRegion(firstSubRegion), cells(0), partialCount(0),
+      level(0), pending(0), inFlight(-1), inFlightSteps(0), sender(hpd, fillFrame, onDone, this), framesSent(0) {
+    partials[0] = '\0';
+    memset(shown, 0xFF, sizeof(shown));
+}
+
+void SAAB_HPD_Progress::setPartialGlyphs(const char* glyphs) {
+    partialCount = 0;
+    while (glyphs && glyphs[partialCount] && partialCount < PROGRESS_MAX_PARTIALS) {
+        partials[partialCount] = glyphs[partialCount];
+        partialCount++;
+    }
+    partials[partialCount] = '\0';
+}
+
+/*!
+  * @brief Create the cell sub-regions, all empty.
+  * @param xPos 
+      Left edge of the bar.
+  * @param yPos 
+      Baseline of the cells.
+  * @param cells 
+      Number of cells, at most PROGRESS_MAX_CELLS.
+  * @param cellWidth 
+      Width of one cell in pixels, the bar is cells * cellWidth wide.
+  * @param fontStyle 
+      Font of the cell characters.
+  * @return ERROR_OK, or the error of the first cell that could not be created.
+      ERROR_REGION_EXISTS without sending anything when a cell would take a sub-region of
+      SAAB_HPD::auxLayout, ERROR_INVALID_ARGS when the cells run past sub-region 0xFF.
+  
+  * @note Blocks for the ACK of each cell, call it once while setting up the screen.
+!*/
+SAAB_HPD::ERROR SAAB_HPD_Progress::begin(uint16_t xPos, uint8_t yPos, uint8_t cells, uint8_t cellWidth, uint8_t fontStyle) {
+    if (cells > PROGRESS_MAX_CELLS) cells = PROGRESS_MAX_CELLS;
+    if (firstSubRegion + cells > 0x100) {
+        return SAAB_HPD::ERROR_INVALID_ARGS;
+    }
+
+    // Preset digits and the BT/CD labels stay untouched, the ICM and mode detection rely on them
+    for (size_t i = 0; i < SAAB_HPD::auxLayoutCount; i++) {
+        const SAAB_HPD::RegionDescriptor &d = SAAB_HPD::auxLayout[i];
+        if (d.regionID == regionID && d.subRegionID0 == 0x02 &&
+            d.subRegionID1 >= firstSubRegion && d.subRegionID1 < firstSubRegion + cells) {
+            return SAAB_HPD::ERROR_REGION_EXISTS;
+        }
+    }
+
+    this->cells = cells;
+    level = 0;
+    pending = 0;
+
+    for (uint8_t i = 0; i < cells; i++) {
+        SAAB_HPD::ERROR result = hpd.makeRegion(regionID, 0x02, firstSubRegion + i, xPos + i * cellWidth, yPos, cellWidth, fontStyle, (char*)" ");
+        if (result != SAAB_HPD::ERROR_OK) {
+            return result;
+        }
+        shown[i] = 0;
+        framesSent++;
+    }
+    return SAAB_HPD::ERROR_OK;
+}
+
+/*!
+  * @brief Move the bar.
+  * @param position 
+      Elapsed time, any unit.
+  * @param duration 
+      Total time in the same unit, 0 empties the bar.
+  * @return void
+  
+  * @note Cheap when nothing changed, meant to be called on every position report.
+!*/
+void SAAB_HPD_Progress::setProgress(uint32_t position, uint32_t duration) {
+    uint16_t resolution = getResolution();
+    uint16_t next = 0;
+    if (duration > 0) {
+        if (position > duration) position = duration;
+        next = (uint64_t)position * resolution / duration;
+    }
+    if (next == level) {
+        return;
+    }
+    level = next;
+
+    for (uint8_t i = 0; i < cells; i++) {
+        if (cellSteps(i) != shown[i]) {
+            pending |= 1UL << i;
+        } else {
+            pending &= ~(1UL << i); // Back to what the SID shows, e.g. after a seek
+        }
+    }
+    sender.send();
+}
+
+uint16_t SAAB_HPD_Progress::getLevel() {
+    return level;
+}
+
+uint16_t SAAB_HPD_Progress::getResolution() {
+    return cells * (partialCount + 1);
+}
+
+uint32_t SAAB_HPD_Progress::getFramesSent() {
+    return framesSent;
+}
+
+uint8_t SAAB_HPD_Progress::cellSteps(uint8_t cell) {
+    uint16_t stepsPerCell = partialCount + 1;
+    uint16_t start = cell * stepsPerCell;
+    if (level <= start) return 0;
+    if (level >= start + stepsPerCell) return stepsPerCell;
+    return level - start;
+}
+
+void SAAB_HPD_Progress::buildCell(SAAB_HPD::SerialFrame &frame, uint8_t cell, uint8_t steps) {
+    char text[2] = {' ', '\0'};
+    uint8_t style = HPD_STYLE_NORMAL;
+    if (steps > partialCount) {
+        style = HPD_STYLE_INVERTED; // Inverted space is a filled cell
+    } else if (steps > 0) {
+        text[0] = partials[steps - 1];
+    }
+    SAAB_HPD::buildChangeRegion(frame, regionID, 0x02, firstSubRegion + cell, HPD_VISIBLE, style, text);
+}
+
+// Builds the frame of the next changed cell, one is in flight at a time
+bool SAAB_HPD_Progress::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_Progress* bar = static_cast<SAAB_HPD_Progress*>(context);
+    if (!bar->pending) {
+        return false;
+    }
+    uint8_t i = 0;
+    while (!(bar->pending & (1UL << i))) i++;
+
+    bar->inFlight = i;
+    bar->inFlightSteps = bar->cellSteps(i);
+    bar->buildCell(frame, i, bar->inFlightSteps);
+    bar->framesSent++;
+    return true;
+}
+
+// A cell only counts as shown once the SID acknowledged it, anything else sends it again
+void SAAB_HPD_Progress::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Progress* bar = static_cast<SAAB_HPD_Progress*>(context);
+    uint8_t i = bar->inFlight;
+    bar->inFlight = -1;
+    if (result != SAAB_HPD::ERROR_OK) {
+        bar->shown[i] = 0xFF;
+        bar->pending |= 1UL << i;
+        return;
+    }
+
+    bar->shown[i] = bar->inFlightSteps;
+    if (bar->cellSteps(i) == bar->shown[i]) {
+        bar->pending &= ~(1UL << i);
+    } else {
+        bar->pending |= 1UL << i; // Moved back while the frame was in flight
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SAAB_HPD_PROGRESS_H
+#define SAAB_HPD_PROGRESS_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+
+// Largest number of character cells in one bar
+#define PROGRESS_MAX_CELLS 32
+
+// Longest list of partial fill glyphs
+#define PROGRESS_MAX_PARTIALS 7
+
+// Playback progress bar built from one character sub-region per cell.
+// A full cell is an inverted space, an empty cell a normal space, optional glyphs show partly filled cells.
+// setProgress() works out which cells changed and sends only those, so a whole song costs about
+// cells * (partials + 1) frames however often it is called.
+// The cells take sub-regions 0x02/firstSubRegion onwards. The default 0x80 leaves room for
+// PROGRESS_MAX_CELLS cells below the clock (0xA0) and the AUX layout (0xBF and up), which the ICM
+// and mode detection use.
+class SAAB_HPD_Progress {
+public:
+    SAAB_HPD_Progress(SAAB_HPD &hpd, uint8_t regionID = 0x01, uint8_t firstSubRegion = 0x80);
+
+    void setPartialGlyphs(const char* glyphs); // Glyphs for 1..n steps of a cell from the left, call before begin()
+    SAAB_HPD::ERROR begin(uint16_t xPos, uint8_t yPos, uint8_t cells = 16, uint8_t cellWidth = 6, uint8_t fontStyle = HPD_FONT_SMALL);
+
+    void setProgress(uint32_t position, uint32_t duration);
+    uint16_t getLevel(); // Filled steps on the SID once pending cells are sent
+    uint16_t getResolution(); // Steps of the whole bar
+    uint32_t getFramesSent();
+
+private:
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    uint8_t firstSubRegion;
+    uint8_t cells;
+    char partials[PROGRESS_MAX_PARTIALS + 1];
+    uint8_t partialCount;
+    uint16_t level;
+    uint8_t shown[PROGRESS_MAX_CELLS]; // Steps of each cell acknowledged by the SID, 0xFF when unknown
+    uint32_t pending; // Bit per cell still to send
+    int8_t inFlight; // Cell waiting for its answer, -1 for none
+    uint8_t inFlightSteps;
+    SAAB_HPD_Sender sender;
+    uint32_t framesSent;
+
+    uint8_t cellSteps(uint8_t cell); // Target steps of a cell for the current level
+    void buildCell(SAAB_HPD::SerialFrame &frame, uint8_t cell, uint8_t steps);
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_PROGRESS_H
@@ -0,0 +1,159 @@
+#include <SAAB_HPD_Radio.h>
+
+// SAAB_HPD_Radio class implementation
+
+SAAB_HPD_Radio::SAAB_HPD_Radio()
+    : psNameSubRegion(RADIO_SUBREGION_NONE), radioTextSubRegion(RADIO_SUBREGION_NONE) {
+    reset();
+}
+
+/*!
+  * @brief Set the sub-regions that carry PS name and radio text separately from the band line.
+  * @param psNameSubRegion 
+      Sub-region of region 0x00 with the PS name, RADIO_SUBREGION_NONE to take it from the band line.
+  * @param radioTextSubRegion 
+      Sub-region of region 0x00 with the radio text, RADIO_SUBREGION_NONE if not used.
+  * @return void
+  
+  * @note The layout differs between ICM versions, check the sub-regions with the sniffer or the journal.
+!*/
+void SAAB_HPD_Radio::setSubRegions(uint16_t psNameSubRegion, uint16_t radioTextSubRegion) {
+    this->psNameSubRegion = psNameSubRegion;
+    this->radioTextSubRegion = radioTextSubRegion;
+}
+
+/*!
+  * @brief Update the radio state from a received frame.
+  * @param frame 
+      Any received frame, only 0x11 updates of region 0x00 are looked at.
+  * @return true if the state changed.
+  
+  * @note Only the sub-region in the frame is decoded, the rest of the state is kept.
+!*/
+bool SAAB_HPD_Radio::process(const SAAB_HPD::SerialFrame &frame) {
+    if (frame.command != 0x11 || frame.data[0] != 0x00 || frame.dlc < 8) {
+        return false;
+    }
+
+    uint16_t subRegion = (frame.data[2] << 8) | frame.data[3];
+    char text[BUFFER_SIZE - 8];
+    SAAB_HPD::regionText(frame, text, sizeof(text));
+
+    const RadioState &current = state.get();
+    RadioState next = current;
+    if (subRegion == RADIO_BAND_SUBREGION) {
+        if (!decodeBandLine(text, next)) return false;
+    } else if (subRegion == psNameSubRegion) {
+        copyText(next.psName, sizeof(next.psName), text);
+    } else if (subRegion == radioTextSubRegion) {
+        copyText(next.radioText, sizeof(next.radioText), text);
+    } else {
+        return false;
+    }
+
+    next.updates = current.updates;
+    if (memcmp(&next, &current, sizeof(next)) == 0) {
+        return false; // Periodic refresh with the same content
+    }
+
+    next.updates++;
+    state.write(next);
+    return true;
+}
+
+/*!
+  * @brief Copy the radio state without locking.
+  * @param out 
+      Receives a consistent copy.
+  * @return void
+  
+  * @note Retries while the writer is updating (seqlock), the writer never waits for readers.
+!*/
+void SAAB_HPD_Radio::read(RadioState &out) {
+    state.read(out);
+}
+
+uint32_t SAAB_HPD_Radio::getVersion() {
+    return state.getVersion();
+}
+
+void SAAB_HPD_Radio::reset() {
+    RadioState empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.band = SAAB_HPD::MODE_UNKNOWN;
+    state.write(empty);
+}
+
+/*!
+  * @brief Decode the band line, e.g. "FM1 P3 101.7 NRJ" or "AM 1008".
+  * @param text 
+      Text of sub-region RADIO_BAND_SUBREGION.
+  * @param next 
+      State to update.
+  * @return false if the text does not start with a band.
+  
+  * @note Tokens after the band: "P<n>" or a single digit is the preset, a number is the frequency, the rest is the PS name.
+!*/
+bool SAAB_HPD_Radio::decodeBandLine(const char* text, RadioState &next) {
+    const char* p = text;
+    if (p[0] == 'F' && p[1] == 'M' && (p[2] == '1' || p[2] == '2')) {
+        next.band = p[2] == '1' ? SAAB_HPD::MODE_FM1 : SAAB_HPD::MODE_FM2;
+        p += 3;
+    } else if (p[0] == 'A' && p[1] == 'M') {
+        next.band = SAAB_HPD::MODE_AM;
+        p += 2;
+    } else {
+        return false;
+    }
+
+    next.preset = 0;
+    next.frequencyKHz = 0;
+    char ps[sizeof(next.psName)] = {0};
+    size_t psLen = 0;
+
+    while (*p) {
+        while (*p == ' ') p++;
+        const char* token = p;
+        while (*p && *p != ' ') p++;
+        size_t len = p - token;
+        if (len == 0) break;
+
+        bool numeric = true;
+        bool dot = false;
+        for (size_t i = 0; i < len; i++) {
+            if (token[i] == '.' && !dot) {
+                dot = true;
+            } else if (token[i] < '0' || token[i] > '9') {
+                numeric = false;
+            }
+        }
+
+        if (len == 2 && token[0] == 'P' && token[1] >= '1' && token[1] <= '6') {
+            next.preset = token[1] - '0';
+        } else if (numeric && len == 1 && next.frequencyKHz == 0 && token[0] >= '1' && token[0] <= '6') {
+            next.preset = token[0] - '0';
+        } else if (numeric && next.frequencyKHz == 0) {
+            // FM is shown in MHz with one decimal, AM in kHz
+            uint32_t whole = 0, tenths = 0;
+            size_t i = 0;
+            for (; i < len && token[i] != '.'; i++) whole = whole * 10 + (token[i] - '0');
+            if (i + 1 < len) tenths = token[i + 1] - '0';
+            next.frequencyKHz = next.band == SAAB_HPD::MODE_AM ? whole : whole * 1000 + tenths * 100;
+        } else {
+            // Everything else belongs to the PS name, words separated by a space
+            if (psLen > 0 && psLen < sizeof(ps) - 1) ps[psLen++] = ' ';
+            for (size_t i = 0; i < len && psLen < sizeof(ps) - 1; i++) ps[psLen++] = token[i];
+        }
+    }
+
+    if (psNameSubRegion == RADIO_SUBREGION_NONE) {
+        memcpy(next.psName, ps, sizeof(next.psName));
+    }
+    return true;
+}
+
+// Text is already trimmed by SAAB_HPD::regionText, the rest of dest is zeroed so states compare with memcmp
+void SAAB_HPD_Radio::copyText(char* dest, size_t size, const char* text) {
+    memset(dest, 0, size);
+    strncpy(dest, text, size - 1);
+}
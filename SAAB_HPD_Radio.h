@@ -0,0 +1,46 @@
+#ifndef SAAB_HPD_RADIO_H
+#define SAAB_HPD_RADIO_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Seqlock.h>
+
+// Sub-region of region 0x00 holding the band line ("FM1 ...", "AM ...")
+#define RADIO_BAND_SUBREGION 0x0013
+
+// Sub-region value for "not configured"
+#define RADIO_SUBREGION_NONE 0xFFFF
+
+// Decodes the ICM radio display frames (0x11, region 0x00) into a structured radio state.
+// Feed it every received frame, readers on other tasks get a consistent copy through read().
+class SAAB_HPD_Radio {
+public:
+    struct RadioState {
+        SAAB_HPD::MODE band;   // MODE_FM1, MODE_FM2, MODE_AM or MODE_UNKNOWN
+        uint8_t preset;        // 1-6, 0 when not on a preset
+        uint32_t frequencyKHz; // 101700 for FM 101.7, 1008 for AM 1008, 0 when not shown
+        char psName[9];        // RDS programme service name
+        char radioText[65];    // RDS radio text
+        uint32_t updates;      // Frames that changed the state
+    };
+
+    SAAB_HPD_Radio();
+
+    // Sub-regions of region 0x00 that carry PS name and radio text on their own, RADIO_SUBREGION_NONE if they do not
+    void setSubRegions(uint16_t psNameSubRegion, uint16_t radioTextSubRegion);
+
+    bool process(const SAAB_HPD::SerialFrame &frame); // true if the state changed
+
+    void read(RadioState &out); // Lock-free consistent copy, safe from any task
+    uint32_t getVersion(); // Changes with every update, even while a write is in progress
+    void reset();
+
+private:
+    SAAB_HPD_Seqlock<RadioState> state;
+    uint16_t psNameSubRegion;
+    uint16_t radioTextSubRegion;
+
+    bool decodeBandLine(const char* text, RadioState &next);
+    static void copyText(char* dest, size_t size, const char* text);
+};
+
+#endif // SAAB_HPD_RADIO_H
@@ -0,0 +1,96 @@
+#include <SAAB_HPD_RegionBuilder.h>
+
+// SAAB_HPD_RegionBuilder class implementation
+
+SAAB_HPD_RegionBuilder::SAAB_HPD_RegionBuilder(SAAB_HPD &hpd)
+    : hpd(hpd), sender(hpd, fillFrame, onDone, this), regionID(0), layout(nullptr), count(0), step(0), attempts(0),
+      running(false), done(nullptr), context(nullptr) {
+}
+
+/*!
+  * @brief Start rebuilding one region from a layout table.
+  * @param regionID 
+      Region to rebuild, descriptors of other regions are skipped.
+  * @param layout 
+      Descriptor table, e.g. SAAB_HPD::auxLayout or a table loaded by SAAB_HPD_Scene.
+  * @param count 
+      Number of descriptors in the table.
+  * @param done 
+      Called from poll() with ok set once the region is drawn, or cleared when a step failed REGION_BUILD_MAX_ATTEMPTS times.
+  * @param context 
+      Passed to done.
+  * @return false while a previous rebuild is still running.
+!*/
+bool SAAB_HPD_RegionBuilder::start(uint8_t regionID, const SAAB_HPD::RegionDescriptor* layout, size_t count, DoneCallback done, void* context) {
+    if (running) {
+        return false;
+    }
+    this->regionID = regionID;
+    this->layout = layout;
+    this->count = count;
+    this->done = done;
+    this->context = context;
+    step = 0;
+    attempts = 0;
+    running = true;
+    sender.send();
+    return true;
+}
+
+void SAAB_HPD_RegionBuilder::cancel() {
+    running = false;
+    sender.stop();
+}
+
+bool SAAB_HPD_RegionBuilder::isRunning() {
+    return running;
+}
+
+void SAAB_HPD_RegionBuilder::finish(bool ok) {
+    running = false;
+    sender.stop();
+    if (done) {
+        done(context, regionID, ok);
+    }
+}
+
+bool SAAB_HPD_RegionBuilder::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_RegionBuilder* builder = static_cast<SAAB_HPD_RegionBuilder*>(context);
+    if (!builder->running) {
+        return false;
+    }
+
+    // Descriptors of other regions are not steps
+    while (builder->step >= 1 && builder->step <= builder->count && builder->layout[builder->step - 1].regionID != builder->regionID) {
+        builder->step++;
+    }
+
+    if (builder->step == 0) {
+        SAAB_HPD::buildClearRegion(frame, builder->regionID, 0x00);
+    } else if (builder->step <= builder->count) {
+        const SAAB_HPD::RegionDescriptor &d = builder->layout[builder->step - 1];
+        SAAB_HPD::buildMakeRegion(frame, d.regionID, d.subRegionID0, d.subRegionID1, d.xPos, d.yPos, d.width, d.fontStyle, d.text);
+    } else {
+        SAAB_HPD::buildDrawRegion(frame, builder->regionID, 0x01);
+    }
+    return true;
+}
+
+void SAAB_HPD_RegionBuilder::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_RegionBuilder* builder = static_cast<SAAB_HPD_RegionBuilder*>(context);
+    if (!builder->running) {
+        return; // Cancelled while the frame was in flight
+    }
+
+    if (result != SAAB_HPD::ERROR_OK) {
+        if (++builder->attempts >= REGION_BUILD_MAX_ATTEMPTS) {
+            builder->finish(false);
+        }
+        return; // The sender tries the same step again
+    }
+
+    builder->attempts = 0;
+    if (builder->step++ > builder->count) {
+        builder->finish(true); // Drawn
+    }
+}
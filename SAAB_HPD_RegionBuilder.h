@@ -0,0 +1,41 @@
+#ifndef SAAB_HPD_REGIONBUILDER_H
+#define SAAB_HPD_REGIONBUILDER_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+
+// Attempts per step before a rebuild gives up, like SAAB_HPD::recreateRegion
+#define REGION_BUILD_MAX_ATTEMPTS 10
+
+// Non-blocking SAAB_HPD::recreateRegion: clears the region, creates its descriptors and draws it,
+// one frame per answer from poll(). A failed step is sent again SENDER_RESEND_MS later, on the wheel
+// instead of delay(), so it is safe to start from a timer, an event or a frame callback.
+class SAAB_HPD_RegionBuilder {
+public:
+    typedef void (*DoneCallback)(void* context, uint8_t regionID, bool ok);
+
+    SAAB_HPD_RegionBuilder(SAAB_HPD &hpd);
+
+    // The layout is read while the rebuild runs and has to stay valid until done is called
+    bool start(uint8_t regionID, const SAAB_HPD::RegionDescriptor* layout, size_t count, DoneCallback done = nullptr, void* context = nullptr);
+    void cancel(); // done is not called
+    bool isRunning();
+
+private:
+    SAAB_HPD &hpd;
+    SAAB_HPD_Sender sender;
+    uint8_t regionID;
+    const SAAB_HPD::RegionDescriptor* layout;
+    size_t count;
+    size_t step; // 0 clears, 1..count create layout[step - 1], count + 1 draws
+    uint8_t attempts;
+    bool running;
+    DoneCallback done;
+    void* context;
+
+    void finish(bool ok);
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_REGIONBUILDER_H
@@ -0,0 +1,391 @@
+#include <SAAB_HPD_Scene.h>
+#include <stdlib.h>
+
+// SAAB_HPD_Scene class implementation
+
+SAAB_HPD_Scene::SAAB_HPD_Scene() {
+    clear();
+}
+
+void SAAB_HPD_Scene::clear() {
+    count = 0;
+    textUsed = 0;
+    hiddenCount = 0;
+    errorLine = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*!
+  * @brief Compile a layout text into the descriptor table.
+  * @param source 
+      Layout text, one sub-region per line.
+  * @return true on success, false on a syntax error or when the scene is full.
+  
+  * @note On failure the scene is left empty and getErrorLine() tells where it stopped.
+!*/
+bool SAAB_HPD_Scene::parse(const char* source) {
+    clear();
+    int lineNumber = 0;
+    while (source && *source) {
+        const char* end = strchr(source, '\n');
+        size_t length = end ? (size_t)(end - source) : strlen(source);
+        lineNumber++;
+
+        // Skip blank lines and comments
+        size_t i = 0;
+        while (i < length && (source[i] == ' ' || source[i] == '\t' || source[i] == '\r')) i++;
+        if (i < length && source[i] != '#') {
+            if (count == SCENE_MAX_REGIONS || !parseLine(source + i, length - i, descriptors[count])) {
+                int line = lineNumber;
+                clear();
+                errorLine = line;
+                return false;
+            }
+            count++;
+        }
+
+        source = end ? end + 1 : source + length;
+    }
+    return true;
+}
+
+int SAAB_HPD_Scene::getErrorLine() const {
+    return errorLine;
+}
+
+uint8_t SAAB_HPD_Scene::getCount() const {
+    return count;
+}
+
+const SAAB_HPD::RegionDescriptor* SAAB_HPD_Scene::getDescriptors() const {
+    return descriptors;
+}
+
+const SAAB_HPD::RegionDescriptor* SAAB_HPD_Scene::find(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1) const {
+    for (uint8_t i = 0; i < count; i++) {
+        const SAAB_HPD::RegionDescriptor &d = descriptors[i];
+        if (d.regionID == regionID && d.subRegionID0 == subRegionID0 && d.subRegionID1 == subRegionID1) {
+            return &d;
+        }
+    }
+    return nullptr;
+}
+
+/*!
+  * @brief Show the scene on the SID.
+  * @param hpd 
+      SID to update.
+  * @param previous 
+      Scene the SID shows now, nullptr to rebuild every region of this scene.
+  * @return true if every region was updated.
+  
+  * @note New sub-regions are created with 0x10. A new text, or a sub-region hidden by an earlier scene coming
+  *       back, is sent as 0x11. Removed ones are hidden. A region with a moved, resized or refonted sub-region,
+  *       or one the SID refuses to update in place, is cleared and rebuilt in full.
+  * @note Blocks for the ACK of every frame, a rebuild also for its retries. Call it from setup() or loop(),
+  *       not from callbacks run by poll().
+!*/
+bool SAAB_HPD_Scene::apply(SAAB_HPD &hpd, const SAAB_HPD_Scene* previous) {
+    memset(&stats, 0, sizeof(stats));
+    hiddenCount = 0;
+    bool ok = true;
+
+    // Every region in either scene, in order of first appearance
+    uint8_t regions[SCENE_MAX_REGIONS * 2];
+    uint8_t regionCount = 0;
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        const SAAB_HPD_Scene* scene = pass == 0 ? this : previous;
+        if (!scene) continue;
+        for (uint8_t i = 0; i < scene->count; i++) {
+            uint8_t id = scene->descriptors[i].regionID;
+            bool seen = false;
+            for (uint8_t r = 0; r < regionCount; r++) {
+                if (regions[r] == id) seen = true;
+            }
+            if (!seen) regions[regionCount++] = id;
+        }
+    }
+
+    for (uint8_t r = 0; r < regionCount; r++) {
+        if (!applyRegion(hpd, regions[r], previous)) {
+            stats.failedRegions++;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+const SAAB_HPD_Scene::ApplyStats& SAAB_HPD_Scene::getApplyStats() const {
+    return stats;
+}
+
+// Clears the region and creates this scene's part of it, its hidden sub-regions are gone afterwards
+bool SAAB_HPD_Scene::rebuildRegion(SAAB_HPD &hpd, uint8_t regionID) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < hiddenCount; i++) {
+        if (hidden[i].regionID != regionID) hidden[kept++] = hidden[i];
+    }
+    hiddenCount = kept;
+    stats.rebuiltRegions++;
+    return hpd.recreateRegion(regionID, descriptors, count);
+}
+
+bool SAAB_HPD_Scene::applyRegion(SAAB_HPD &hpd, uint8_t regionID, const SAAB_HPD_Scene* previous) {
+    if (!previous) {
+        return rebuildRegion(hpd, regionID);
+    }
+
+    // Position, width and font are fixed once a sub-region exists, changing one needs the region rebuilt
+    for (uint8_t i = 0; i < count; i++) {
+        const SAAB_HPD::RegionDescriptor &d = descriptors[i];
+        if (d.regionID != regionID) continue;
+        const SAAB_HPD::RegionDescriptor* old = previous->find(d.regionID, d.subRegionID0, d.subRegionID1);
+        if (!old) old = previous->findHidden(d.regionID, d.subRegionID0, d.subRegionID1);
+        if (old && !sameGeometry(*old, d)) {
+            return rebuildRegion(hpd, regionID);
+        }
+    }
+
+    // Sub-regions still hidden from earlier scenes stay known
+    for (uint8_t i = 0; i < previous->hiddenCount; i++) {
+        const SAAB_HPD::RegionDescriptor &d = previous->hidden[i];
+        if (d.regionID == regionID && !find(d.regionID, d.subRegionID0, d.subRegionID1)) {
+            addHidden(d);
+        }
+    }
+
+    bool changed = false;
+    for (uint8_t i = 0; i < count; i++) {
+        const SAAB_HPD::RegionDescriptor &d = descriptors[i];
+        if (d.regionID != regionID) continue;
+
+        SAAB_HPD::ERROR result;
+        const SAAB_HPD::RegionDescriptor* old = previous->find(d.regionID, d.subRegionID0, d.subRegionID1);
+        if (old && sameText(old->text, d.text)) {
+            stats.unchanged++;
+            continue;
+        } else if (old || previous->findHidden(d.regionID, d.subRegionID0, d.subRegionID1)) {
+            // Exists on the SID, a new text or shown again goes in place
+            result = hpd.changeRegion(d.regionID, d.subRegionID0, d.subRegionID1, HPD_VISIBLE, HPD_STYLE_NORMAL, const_cast<char*>(d.text));
+            if (result == SAAB_HPD::ERROR_OK) stats.updated++;
+        } else {
+            result = hpd.makeRegion(d.regionID, d.subRegionID0, d.subRegionID1, d.xPos, d.yPos, d.width, d.fontStyle, const_cast<char*>(d.text));
+            if (result == SAAB_HPD::ERROR_OK) stats.created++;
+        }
+        if (result != SAAB_HPD::ERROR_OK) {
+            // Not possible in place, e.g. a sub-region the SID kept from before this scene was loaded
+            return rebuildRegion(hpd, regionID);
+        }
+        changed = true;
+    }
+
+    for (uint8_t i = 0; i < previous->count; i++) {
+        const SAAB_HPD::RegionDescriptor &d = previous->descriptors[i];
+        if (d.regionID != regionID || find(d.regionID, d.subRegionID0, d.subRegionID1)) continue;
+        hpd.changeRegion(d.regionID, d.subRegionID0, d.subRegionID1, HPD_HIDDEN, HPD_STYLE_NORMAL);
+        addHidden(d);
+        stats.hidden++;
+        changed = true;
+    }
+
+    if (changed) {
+        return hpd.drawRegion(regionID, 0x01) == SAAB_HPD::ERROR_OK;
+    }
+    return true;
+}
+
+bool SAAB_HPD_Scene::sameGeometry(const SAAB_HPD::RegionDescriptor &a, const SAAB_HPD::RegionDescriptor &b) {
+    return a.xPos == b.xPos && a.yPos == b.yPos && a.width == b.width && a.fontStyle == b.fontStyle;
+}
+
+bool SAAB_HPD_Scene::sameText(const char* a, const char* b) {
+    if (!a || !b) {
+        return a == b;
+    }
+    return strcmp(a, b) == 0;
+}
+
+const SAAB_HPD::RegionDescriptor* SAAB_HPD_Scene::findHidden(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1) const {
+    for (uint8_t i = 0; i < hiddenCount; i++) {
+        const SAAB_HPD::RegionDescriptor &d = hidden[i];
+        if (d.regionID == regionID && d.subRegionID0 == subRegionID0 && d.subRegionID1 == subRegionID1) {
+            return &d;
+        }
+    }
+    return nullptr;
+}
+
+// Without room the sub-region is forgotten, showing it again then costs a rebuild of its region
+void SAAB_HPD_Scene::addHidden(const SAAB_HPD::RegionDescriptor &d) {
+    if (hiddenCount == SCENE_MAX_REGIONS || findHidden(d.regionID, d.subRegionID0, d.subRegionID1)) {
+        return;
+    }
+    hidden[hiddenCount] = d;
+    hidden[hiddenCount].text = nullptr; // Points into the other scene's pool, only the geometry is kept
+    hiddenCount++;
+}
+
+// Parses "region sub0 sub1 x y width font [text]"
+bool SAAB_HPD_Scene::parseLine(const char* line, size_t length, SAAB_HPD::RegionDescriptor &d) {
+    unsigned long values[6];
+    size_t pos = 0;
+    char token[16];
+
+    // Next space separated token into token[], false at the end of the line
+    auto nextToken = [&]() {
+        while (pos < length && (line[pos] == ' ' || line[pos] == '\t')) pos++;
+        size_t n = 0;
+        while (pos < length && line[pos] != ' ' && line[pos] != '\t' && line[pos] != '\r') {
+            if (n < sizeof(token) - 1) token[n++] = line[pos];
+            pos++;
+        }
+        token[n] = '\0';
+        return n > 0;
+    };
+
+    const unsigned long limits[6] = {0xFF, 0xFF, 0xFF, 0xFFFF, 0xFF, 0xFF};
+    for (uint8_t i = 0; i < 6; i++) {
+        if (!nextToken()) return false;
+        char* end;
+        values[i] = strtoul(token, &end, 0);
+        if (*end != '\0' || values[i] > limits[i]) return false;
+    }
+
+    if (!nextToken()) return false;
+    uint8_t font;
+    if (strcmp(token, "small") == 0) font = HPD_FONT_SMALL;
+    else if (strcmp(token, "medium") == 0) font = HPD_FONT_MEDIUM;
+    else if (strcmp(token, "large") == 0) font = HPD_FONT_LARGE;
+    else if (strcmp(token, "time") == 0) font = HPD_FONT_TIME;
+    else if (strcmp(token, "time2") == 0) font = HPD_FONT_TIME_2;
+    else {
+        char* end;
+        unsigned long value = strtoul(token, &end, 0);
+        if (*end != '\0' || value > 0xFF) return false;
+        font = value;
+    }
+
+    d.regionID = values[0];
+    d.subRegionID0 = values[1];
+    d.subRegionID1 = values[2];
+    d.xPos = values[3];
+    d.yPos = values[4];
+    d.width = values[5];
+    d.fontStyle = font;
+    d.text = nullptr;
+
+    // Text to the end of the line, quotes keep the spaces
+    while (pos < length && (line[pos] == ' ' || line[pos] == '\t')) pos++;
+    size_t end = length;
+    while (end > pos && (line[end - 1] == ' ' || line[end - 1] == '\t' || line[end - 1] == '\r')) end--;
+    if (end - pos >= 2 && line[pos] == '"' && line[end - 1] == '"') {
+        pos++;
+        end--;
+    } else if (end == pos || (end - pos == 1 && line[pos] == '-')) {
+        return true; // No text
+    }
+
+    size_t textLength = end - pos;
+    if (textLength > BUFFER_SIZE - 14 || textUsed + textLength + 1 > SCENE_TEXT_POOL) {
+        return false;
+    }
+    char* text = &textPool[textUsed];
+    memcpy(text, line + pos, textLength);
+    text[textLength] = '\0';
+    textUsed += textLength + 1;
+    d.text = text;
+    return true;
+}
+
+// SAAB_HPD_SceneWatcher class implementation
+
+SAAB_HPD_SceneWatcher::SAAB_HPD_SceneWatcher(SAAB_HPD &hpd, SourceCallback source, void* context)
+    : hpd(hpd), source(source), context(context), current(0), loaded(false), sourceHash(0), lastCheck(0),
+      reloadCallback(nullptr), reloads(0) {
+    text[0] = '\0';
+}
+
+/*!
+  * @brief Load the layout and rebuild its regions on the SID.
+  * @return false if the source has no layout or it does not parse, nothing is sent then.
+  
+  * @note Blocks for the ACK of every frame like SAAB_HPD_Scene::apply().
+!*/
+bool SAAB_HPD_SceneWatcher::begin() {
+    loaded = false;
+    lastCheck = hpd.getTimers().now();
+    uint32_t hash;
+    if (!read(hash)) {
+        return false;
+    }
+    sourceHash = hash;
+    if (!scenes[current].parse(text)) {
+        return false;
+    }
+    scenes[current].apply(hpd);
+    loaded = true;
+    return true;
+}
+
+bool SAAB_HPD_SceneWatcher::check() {
+    unsigned long now = hpd.getTimers().now();
+    if (now - lastCheck < SCENE_WATCH_INTERVAL_MS) {
+        return false;
+    }
+    lastCheck = now;
+    return reload();
+}
+
+/*!
+  * @brief Read the layout and apply it if the text changed since the last read.
+  * @return true when a new scene was parsed and its difference applied.
+  
+  * @note A text that does not parse is reported through the reload callback once, the SID stays on the previous scene.
+  * @note Before a successful begin() a changed text is applied in full.
+!*/
+bool SAAB_HPD_SceneWatcher::reload() {
+    uint32_t hash;
+    if (!read(hash) || hash == sourceHash) {
+        return false;
+    }
+    sourceHash = hash;
+
+    uint8_t next = current ^ 1;
+    if (!scenes[next].parse(text)) {
+        if (reloadCallback) reloadCallback(scenes[next], false);
+        return false;
+    }
+    scenes[next].apply(hpd, loaded ? &scenes[current] : nullptr);
+    current = next;
+    loaded = true;
+    reloads++;
+    if (reloadCallback) reloadCallback(scenes[current], true);
+    return true;
+}
+
+void SAAB_HPD_SceneWatcher::setReloadCallback(ReloadCallback callback) {
+    reloadCallback = callback;
+}
+
+const SAAB_HPD_Scene& SAAB_HPD_SceneWatcher::getScene() {
+    return scenes[current];
+}
+
+uint32_t SAAB_HPD_SceneWatcher::getReloadCount() {
+    return reloads;
+}
+
+// FNV-1a over the text, a changed file is parsed again
+bool SAAB_HPD_SceneWatcher::read(uint32_t &hash) {
+    size_t length = source(context, text, sizeof(text) - 1);
+    if (length == 0 || length > sizeof(text) - 1) {
+        return false;
+    }
+    text[length] = '\0';
+
+    hash = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619UL;
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef SAAB_HPD_SCENE_H
+#define SAAB_HPD_SCENE_H
+
+#include <SAAB_HPD.h>
+
+// Sub-regions in one scene and bytes for their texts
+#define SCENE_MAX_REGIONS 64
+#define SCENE_TEXT_POOL 1024
+
+// Largest layout text the watcher reads, and how often check() reads it
+#define SCENE_SOURCE_SIZE 4096
+#define SCENE_WATCH_INTERVAL_MS 500
+
+// Screen layout compiled from a text file into a SAAB_HPD::RegionDescriptor table.
+// One sub-region per line, fields separated by spaces, the text runs to the end of the line:
+//
+//   # region sub0 sub1 x   y  width font   text
+//   0x01     0x02 0xDF 187 31 230   medium Play
+//   0x01     0x02 0xCD 142 34 30    large  "BT"
+//
+// Numbers are decimal or 0x hex, fonts are small, medium, large, time, time2 or a number.
+// Quotes keep leading and trailing spaces, a missing text or - creates the sub-region without one.
+// The text comes from wherever the application keeps it (flash file system, serial, a string literal),
+// so a layout can be changed without touching recreateAuxRegion(). Applying a new scene on top of the
+// previous one only sends the differences.
+class SAAB_HPD_Scene {
+public:
+    struct ApplyStats {
+        uint8_t created; // Sub-regions new on the SID, sent as 0x10
+        uint8_t updated; // Sub-regions with a new text or shown again after being hidden, sent as 0x11
+        uint8_t hidden; // Sub-regions no longer in the scene, the SID cannot delete single ones
+        uint8_t unchanged;
+        uint8_t rebuiltRegions; // Regions cleared and created again in full
+        uint8_t failedRegions;
+    };
+
+    SAAB_HPD_Scene();
+
+    bool parse(const char* source); // Replaces the scene, false on a syntax error
+    int getErrorLine() const; // Line of the last syntax error, 0 if none
+    void clear();
+
+    uint8_t getCount() const;
+    const SAAB_HPD::RegionDescriptor* getDescriptors() const;
+    const SAAB_HPD::RegionDescriptor* find(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1) const;
+
+    // Puts the scene on the SID, only the differences when previous is the scene it currently shows
+    bool apply(SAAB_HPD &hpd, const SAAB_HPD_Scene* previous = nullptr);
+    const ApplyStats& getApplyStats() const;
+
+private:
+    SAAB_HPD::RegionDescriptor descriptors[SCENE_MAX_REGIONS];
+    uint8_t count;
+    char textPool[SCENE_TEXT_POOL];
+    size_t textUsed;
+    int errorLine;
+    ApplyStats stats;
+
+    // Sub-regions hidden on the SID by an earlier apply(), they still exist there with this geometry
+    SAAB_HPD::RegionDescriptor hidden[SCENE_MAX_REGIONS];
+    uint8_t hiddenCount;
+
+    bool parseLine(const char* line, size_t length, SAAB_HPD::RegionDescriptor &d);
+    static bool sameGeometry(const SAAB_HPD::RegionDescriptor &a, const SAAB_HPD::RegionDescriptor &b);
+    static bool sameText(const char* a, const char* b);
+    const SAAB_HPD::RegionDescriptor* findHidden(uint8_t regionID, uint8_t subRegionID0, uint8_t subRegionID1) const;
+    void addHidden(const SAAB_HPD::RegionDescriptor &d);
+    bool rebuildRegion(SAAB_HPD &hpd, uint8_t regionID);
+    bool applyRegion(SAAB_HPD &hpd, uint8_t regionID, const SAAB_HPD_Scene* previous);
+};
+
+// Keeps the SID on the layout an application reads from a source of its own (a file on LittleFS or SD,
+// a buffer filled over serial). check() reads the source, and when the text changed it parses the new
+// scene and applies only the difference. A text that does not parse leaves the SID on the previous scene.
+// apply() blocks for the answers, so check() and reload() belong in loop(), not in callbacks run by poll().
+class SAAB_HPD_SceneWatcher {
+public:
+    // Copies the current layout text into buffer and returns its length, 0 when there is none and more
+    // than size when it does not fit
+    typedef size_t (*SourceCallback)(void* context, char* buffer, size_t size);
+    typedef void (*ReloadCallback)(const SAAB_HPD_Scene &scene, bool ok);
+
+    SAAB_HPD_SceneWatcher(SAAB_HPD &hpd, SourceCallback source, void* context = nullptr);
+
+    bool begin(); // Reads, parses and rebuilds every region of the scene, nothing is sent when it does not parse
+    bool check(); // Reads the source every SCENE_WATCH_INTERVAL_MS, true when a changed scene was applied
+    bool reload(); // Reads the source now, e.g. after a file system change notification or an upload
+    void setReloadCallback(ReloadCallback callback);
+
+    const SAAB_HPD_Scene &getScene();
+    uint32_t getReloadCount();
+
+private:
+    SAAB_HPD &hpd;
+    SourceCallback source;
+    void* context;
+    SAAB_HPD_Scene scenes[2]; // The one on the SID and the one being loaded
+    uint8_t current;
+    bool loaded;
+    uint32_t sourceHash; // Of the text last read, parsed or not
+    unsigned long lastCheck;
+    ReloadCallback reloadCallback;
+    uint32_t reloads;
+    char text[SCENE_SOURCE_SIZE];
+
+    bool read(uint32_t &hash); // Fills text, false when the source has nothing usable
+};
+
+#endif // SAAB_HPD_SCENE_H
@@ -0,0 +1,66 @@
+#include <SAAB_HPD_Sender.h>
+
+// SAAB_HPD_Sender class implementation
+
+SAAB_HPD_Sender::SAAB_HPD_Sender(SAAB_HPD &hpd, FillCallback fill, DoneCallback done, void* context)
+    : hpd(hpd), fill(fill), done(done), context(context), inFlight(false), retryTimer(0) {
+}
+
+/*!
+  * @brief Queue the next frame of the widget if the TX slot is free.
+  * @return void
+  
+  * @note fill is only called when the frame can be queued right away, so it may record what it sent.
+  * @note While the slot is busy the call is repeated every SENDER_RETRY_MS from poll().
+!*/
+void SAAB_HPD_Sender::send() {
+    if (isBusy()) {
+        return; // The answer or the retry sends the next frame
+    }
+    if (hpd.isTxBusy()) {
+        retry(SENDER_RETRY_MS);
+        return;
+    }
+
+    SAAB_HPD::SerialFrame frame;
+    if (!fill(context, frame)) {
+        return;
+    }
+    if (!hpd.queuePreparedSidData(frame, onAnswer, this)) {
+        retry(SENDER_RETRY_MS);
+        return;
+    }
+    inFlight = true;
+}
+
+void SAAB_HPD_Sender::stop() {
+    hpd.getTimers().cancel(retryTimer);
+    retryTimer = 0;
+}
+
+bool SAAB_HPD_Sender::isBusy() {
+    return inFlight || hpd.getTimers().isScheduled(retryTimer);
+}
+
+void SAAB_HPD_Sender::retry(uint32_t delay) {
+    SAAB_HPD_Timer &timers = hpd.getTimers();
+    timers.cancel(retryTimer);
+    retryTimer = timers.schedule(delay, onRetry, this);
+}
+
+void SAAB_HPD_Sender::onRetry(void* context) {
+    SAAB_HPD_Sender* sender = static_cast<SAAB_HPD_Sender*>(context);
+    sender->retryTimer = 0;
+    sender->send();
+}
+
+void SAAB_HPD_Sender::onAnswer(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_Sender* sender = static_cast<SAAB_HPD_Sender*>(context);
+    sender->inFlight = false;
+    sender->done(sender->context, result);
+    if (result == SAAB_HPD::ERROR_OK) {
+        sender->send();
+    } else {
+        sender->retry(SENDER_RESEND_MS);
+    }
+}
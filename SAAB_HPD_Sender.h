@@ -0,0 +1,40 @@
+#ifndef SAAB_HPD_SENDER_H
+#define SAAB_HPD_SENDER_H
+
+#include <SAAB_HPD.h>
+
+// Delay before trying again while the TX slot is busy
+#define SENDER_RETRY_MS 2
+
+// Delay before sending again after a NACK, a missing answer or a collision
+#define SENDER_RESEND_MS 100
+
+// Queue-or-retry-later for widgets that keep the SID in sync with their own state.
+// One frame is in flight at a time. The widget builds it in the fill callback when the TX slot is free,
+// and learns its outcome in the done callback, so content only counts as shown once the SID acknowledged it.
+// After a failure the next fill comes SENDER_RESEND_MS later, nothing here ever blocks inside poll().
+class SAAB_HPD_Sender {
+public:
+    typedef bool (*FillCallback)(void* context, SAAB_HPD::SerialFrame &frame); // Builds the next complete frame, false when nothing is due
+    typedef SAAB_HPD::TxDoneCallback DoneCallback; // Outcome of the frame built by the last fill
+
+    SAAB_HPD_Sender(SAAB_HPD &hpd, FillCallback fill, DoneCallback done, void* context);
+
+    void send(); // Call after the widget state changed, does nothing while a frame is in flight or a retry waits
+    void stop(); // Cancels a waiting retry, the answer of a frame in flight still reaches done
+    bool isBusy(); // A frame is in flight or a retry waits
+
+private:
+    SAAB_HPD &hpd;
+    FillCallback fill;
+    DoneCallback done;
+    void* context;
+    bool inFlight;
+    SAAB_HPD_Timer::TimerId retryTimer;
+
+    void retry(uint32_t delay);
+    static void onRetry(void* context);
+    static void onAnswer(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_SENDER_H
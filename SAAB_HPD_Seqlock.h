@@ -0,0 +1,52 @@
+#ifndef SAAB_HPD_SEQLOCK_H
+#define SAAB_HPD_SEQLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Single writer, many reader state holder without locks.
+// The writer bumps the sequence to odd before and to even after a write, readers retry until they copied
+// the value between two equal even sequence numbers. Readers never block the writer.
+template <typename T>
+class SAAB_HPD_Seqlock {
+public:
+    SAAB_HPD_Seqlock() : sequence(0) {
+        memset(&value, 0, sizeof(value));
+    }
+
+    // Consistent copy, safe from any task
+    void read(T &out) const {
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            if (before & 1) continue; // Write in progress
+            memcpy(&out, &value, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+    }
+
+    // Writer side only
+    void write(const T &next) {
+        sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = next;
+        sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    // Writer side only, the current value without the retry loop
+    const T &get() const {
+        return value;
+    }
+
+    // Changes with every write, odd while a write is in progress
+    uint32_t getVersion() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+
+private:
+    T value;
+    std::atomic<uint32_t> sequence;
+};
+
+#endif // SAAB_HPD_SEQLOCK_H
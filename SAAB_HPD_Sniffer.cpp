@@ -0,0 +1,210 @@
+#include <SAAB_HPD_Sniffer.h>
+
+// SAAB_HPD_Sniffer class implementation
+
+SAAB_HPD_Sniffer::SAAB_HPD_Sniffer(HardwareSerial &icmLine, HardwareSerial &sidLine)
+    : icmSerial(icmLine), sidSerial(sidLine), icmParser(icmLine), sidParser(sidLine),
+      commandPending(false), pendingSince(0), timingCount(0), unsolicited(0), syncLosses(0), pairCallback(nullptr) {
+    sidParser.setSyncPattern(ackPattern, ackPatternLength);
+}
+
+void SAAB_HPD_Sniffer::begin(int8_t icmRxPin, int8_t sidRxPin) {
+    icmSerial.begin(SID_BAUD_RATE, SERIAL_8N1, icmRxPin, -1);
+    sidSerial.begin(SID_BAUD_RATE, SERIAL_8N1, sidRxPin, -1);
+}
+
+/*!
+  * @brief Read both lines and pair ICM commands with SID answers.
+  * @return void
+  
+  * @note The lines are read alternately one frame at a time, the ICM waits for an answer before its next command, so
+  *       a backlog of several commands and answers is still paired in order.
+  * @note Each frame is timestamped when its last byte is read, call it often for accurate timing.
+!*/
+void SAAB_HPD_Sniffer::poll() {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        while (icmSerial.available()) {
+            progress = true;
+            uint8_t byteReceived = icmSerial.read();
+            if (parseLine(icmParser, byteReceived, icmFrame, syncPattern)) {
+                onIcmFrame(micros());
+                break; // Its answer comes before the next command
+            }
+        }
+        while (sidSerial.available()) {
+            progress = true;
+            uint8_t byteReceived = sidSerial.read();
+            if (parseLine(sidParser, byteReceived, sidFrame, ackPattern)) {
+                onSidFrame(micros());
+                break;
+            }
+        }
+    }
+    expirePending(micros());
+}
+
+void SAAB_HPD_Sniffer::feedIcm(const uint8_t* data, size_t len, uint32_t timestamp) {
+    for (size_t i = 0; i < len; i++) {
+        if (parseLine(icmParser, data[i], icmFrame, syncPattern)) {
+            onIcmFrame(timestamp);
+        }
+    }
+}
+
+void SAAB_HPD_Sniffer::feedSid(const uint8_t* data, size_t len, uint32_t timestamp) {
+    for (size_t i = 0; i < len; i++) {
+        if (parseLine(sidParser, data[i], sidFrame, ackPattern)) {
+            onSidFrame(timestamp);
+        }
+    }
+}
+
+void SAAB_HPD_Sniffer::setPairCallback(PairCallback callback) {
+    pairCallback = callback;
+}
+
+const SAAB_HPD_Sniffer::CommandTiming* SAAB_HPD_Sniffer::getTimings(uint8_t &count) {
+    count = timingCount;
+    return timings;
+}
+
+uint32_t SAAB_HPD_Sniffer::getUnsolicitedCount() {
+    return unsolicited;
+}
+
+uint32_t SAAB_HPD_Sniffer::getSyncLossCount() {
+    return syncLosses;
+}
+
+/*!
+  * @brief Print the command/response timing table.
+  * @param out 
+      Where to print, Serial by default.
+  * @return void
+!*/
+void SAAB_HPD_Sniffer::printTable(Print &out) {
+    out.println("\n--- ICM command timing ---");
+    out.println("CMD   COUNT    ACK   NACK  REPLY  TMOUT  ERR  LAST(us)   MIN(us)   MAX(us)  MEAN(us)");
+    for (uint8_t i = 0; i < timingCount; i++) {
+        const CommandTiming &t = timings[i];
+        uint32_t answered = t.acks + t.nacks + t.replies;
+        out.printf("0x%02X %6u %6u %6u %6u %6u 0x%02X %9u %9u %9u %9u\n",
+                   t.command, (unsigned)t.count, (unsigned)t.acks, (unsigned)t.nacks, (unsigned)t.replies, (unsigned)t.timeouts,
+                   t.lastError, (unsigned)t.lastLatencyMicros, (unsigned)(answered ? t.minLatencyMicros : 0),
+                   (unsigned)t.maxLatencyMicros, (unsigned)(answered ? t.totalLatencyMicros / answered : 0));
+    }
+    out.printf("Unsolicited SID frames: %u\n", (unsigned)unsolicited);
+    out.printf("Sync losses: %u\n", (unsigned)syncLosses);
+    out.println("--------------------------");
+}
+
+void SAAB_HPD_Sniffer::reset() {
+    timingCount = 0;
+    unsolicited = 0;
+    syncLosses = 0;
+    commandPending = false;
+}
+
+/*!
+  * @brief Run one byte through the parser of a line.
+  * @param parser 
+      icmParser or sidParser.
+  * @param byteReceived 
+      Byte read from that line.
+  * @param frame 
+      Filled in when a frame completes.
+  * @param pattern 
+      Sync pattern of the parser.
+  * @return true when a frame completed, including the sync pattern itself.
+  
+  * @note The sync pattern is a complete frame (the 0x81 query, the ACK), the parser consumes it while syncing
+  *       so it is handed on here. Otherwise the first answer after every sync would be lost.
+  * @note Parser events are not delivered by anyone, they are dropped and sync losses counted instead.
+!*/
+bool SAAB_HPD_Sniffer::parseLine(SAAB_HPD &parser, uint8_t byteReceived, SAAB_HPD::SerialFrame &frame, const uint8_t* pattern) {
+    bool wasSynced = parser.isSynced();
+    bool complete = parser.parseByte(byteReceived, frame);
+    parser.clearEvents();
+
+    if (wasSynced && !parser.isSynced()) {
+        syncLosses++;
+    } else if (!wasSynced && parser.isSynced()) {
+        frame.dlc = pattern[0];
+        frame.command = pattern[1];
+        memset(frame.data, 0, sizeof(frame.data));
+        memcpy(frame.data, &pattern[3], frame.dlc - 2);
+        frame.checksum = pattern[frame.dlc + 1];
+        complete = true;
+    }
+    return complete;
+}
+
+void SAAB_HPD_Sniffer::onIcmFrame(uint32_t timestamp) {
+    // The ICM only sends the next command after the answer, a still pending one was not answered
+    expirePending(timestamp);
+    if (commandPending) {
+        CommandTiming* t = timingFor(pendingCommand.command);
+        if (t) t->timeouts++;
+        if (pairCallback) pairCallback(pendingCommand, nullptr, 0);
+    }
+
+    CommandTiming* t = timingFor(icmFrame.command);
+    if (t) t->count++;
+
+    pendingCommand = icmFrame;
+    pendingSince = timestamp;
+    commandPending = true;
+}
+
+void SAAB_HPD_Sniffer::onSidFrame(uint32_t timestamp) {
+    if (!commandPending) {
+        unsolicited++;
+        return;
+    }
+
+    uint32_t latency = timestamp - pendingSince;
+    CommandTiming* t = timingFor(pendingCommand.command);
+    if (t) {
+        if (sidFrame.command == 0xFF) {
+            t->acks++;
+        } else if (sidFrame.command == 0xFE) {
+            t->nacks++;
+            t->lastError = sidFrame.data[0];
+        } else {
+            t->replies++;
+        }
+        t->lastLatencyMicros = latency;
+        if (latency < t->minLatencyMicros) t->minLatencyMicros = latency;
+        if (latency > t->maxLatencyMicros) t->maxLatencyMicros = latency;
+        t->totalLatencyMicros += latency;
+    }
+
+    commandPending = false;
+    if (pairCallback) pairCallback(pendingCommand, &sidFrame, latency);
+}
+
+void SAAB_HPD_Sniffer::expirePending(uint32_t now) {
+    if (commandPending && now - pendingSince >= SNIFFER_RESPONSE_TIMEOUT_US) {
+        CommandTiming* t = timingFor(pendingCommand.command);
+        if (t) t->timeouts++;
+        commandPending = false;
+        if (pairCallback) pairCallback(pendingCommand, nullptr, 0);
+    }
+}
+
+SAAB_HPD_Sniffer::CommandTiming* SAAB_HPD_Sniffer::timingFor(uint8_t command) {
+    for (uint8_t i = 0; i < timingCount; i++) {
+        if (timings[i].command == command) return &timings[i];
+    }
+    if (timingCount == SNIFFER_MAX_COMMANDS) {
+        return nullptr; // Table full, command is not tracked
+    }
+
+    CommandTiming &t = timings[timingCount++];
+    memset(&t, 0, sizeof(t));
+    t.command = command;
+    t.minLatencyMicros = UINT32_MAX;
+    return &t;
+}
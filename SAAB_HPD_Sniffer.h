@@ -0,0 +1,77 @@
+#ifndef SAAB_HPD_SNIFFER_H
+#define SAAB_HPD_SNIFFER_H
+
+#include <SAAB_HPD.h>
+
+// Maximum number of different ICM commands tracked in the timing table
+#define SNIFFER_MAX_COMMANDS 24
+
+// Commands without a response within this time are counted as timeouts
+#define SNIFFER_RESPONSE_TIMEOUT_US 100000UL
+
+// Passive tap on both directions of the ICM <-> SID line.
+// Each direction has its own parser, every ICM command is paired with the SID answer that follows it.
+class SAAB_HPD_Sniffer {
+public:
+    // Timing of one ICM command byte
+    struct CommandTiming {
+        uint8_t command;
+        uint32_t count;              // Commands seen
+        uint32_t acks;               // Answered with 0xFF
+        uint32_t nacks;              // Answered with 0xFE
+        uint32_t replies;            // Answered with a data frame (0x82, 0x84, 0x95, 0x97, ...)
+        uint32_t timeouts;           // No answer within SNIFFER_RESPONSE_TIMEOUT_US
+        uint8_t lastError;           // Last 0xFE error code, 0x00 if none seen
+        uint32_t lastLatencyMicros;  // End of command to end of answer
+        uint32_t minLatencyMicros;
+        uint32_t maxLatencyMicros;
+        uint64_t totalLatencyMicros; // For the mean, divide by acks + nacks + replies
+    };
+
+    // Called for every paired command, response is nullptr on timeout
+    typedef void (*PairCallback)(const SAAB_HPD::SerialFrame &command, const SAAB_HPD::SerialFrame* response, uint32_t latencyMicros);
+
+    SAAB_HPD_Sniffer(HardwareSerial &icmLine, HardwareSerial &sidLine);
+
+    void begin(int8_t icmRxPin, int8_t sidRxPin); // Both ports are opened RX only
+    void poll(); // Reads both lines and pairs frames
+
+    // Feed bytes from a capture instead of the serial ports, timestamps in micros
+    void feedIcm(const uint8_t* data, size_t len, uint32_t timestamp);
+    void feedSid(const uint8_t* data, size_t len, uint32_t timestamp);
+
+    void setPairCallback(PairCallback callback);
+
+    const CommandTiming* getTimings(uint8_t &count);
+    uint32_t getUnsolicitedCount(); // SID frames without a pending command
+    uint32_t getSyncLossCount(); // Invalid DLC or checksum on either line, the frame is lost until the next sync
+    void printTable(Print &out = Serial);
+    void reset();
+
+private:
+    HardwareSerial &icmSerial;
+    HardwareSerial &sidSerial;
+    SAAB_HPD icmParser; // Parses ICM -> SID, syncs on the 0x81 query
+    SAAB_HPD sidParser; // Parses SID -> ICM, syncs on the OK response
+
+    SAAB_HPD::SerialFrame icmFrame;
+    SAAB_HPD::SerialFrame sidFrame;
+    SAAB_HPD::SerialFrame pendingCommand;
+    bool commandPending;
+    uint32_t pendingSince;
+
+    CommandTiming timings[SNIFFER_MAX_COMMANDS];
+    uint8_t timingCount;
+    uint32_t unsolicited;
+    uint32_t syncLosses;
+
+    PairCallback pairCallback;
+
+    bool parseLine(SAAB_HPD &parser, uint8_t byteReceived, SAAB_HPD::SerialFrame &frame, const uint8_t* pattern);
+    void onIcmFrame(uint32_t timestamp);
+    void onSidFrame(uint32_t timestamp);
+    void expirePending(uint32_t now);
+    CommandTiming* timingFor(uint8_t command);
+};
+
+#endif // SAAB_HPD_SNIFFER_H
@@ -0,0 +1,246 @@
+#include <SAAB_HPD_TextLayout.h>
+
+// SAAB_HPD_TextLayout class implementation
+
+SAAB_HPD_TextLayout::SAAB_HPD_TextLayout(SAAB_HPD &hpd, uint8_t regionID)
+    : hpd(hpd), regionID(regionID), style(HPD_STYLE_NORMAL), rowCount(0), rowsUsed(0),
+      widthSmall(LAYOUT_WIDTH_SMALL), widthMedium(LAYOUT_WIDTH_MEDIUM), widthLarge(LAYOUT_WIDTH_LARGE),
+      pending(0), inFlight(-1), inFlightStyle(HPD_STYLE_NORMAL), sender(hpd, fillFrame, onDone, this), framesSent(0) {
+    inFlightText[0] = '\0';
+}
+
+bool SAAB_HPD_TextLayout::addRow(uint8_t subRegionID0, uint8_t subRegionID1, uint16_t width, uint8_t fontStyle) {
+    if (rowCount == LAYOUT_MAX_ROWS) {
+        return false;
+    }
+    Row &row = rows[rowCount++];
+    row.subRegionID0 = subRegionID0;
+    row.subRegionID1 = subRegionID1;
+    row.width = width;
+    row.fontStyle = fontStyle;
+    row.text[0] = '\0';
+    row.shown[0] = '\0';
+    row.shownValid = false;
+    return true;
+}
+
+void SAAB_HPD_TextLayout::setCharWidth(uint8_t fontStyle, uint8_t width) {
+    if (width == 0) return;
+    if (fontStyle == HPD_FONT_LARGE) widthLarge = width;
+    else if (fontStyle == HPD_FONT_MEDIUM) widthMedium = width;
+    else widthSmall = width;
+}
+
+void SAAB_HPD_TextLayout::setStyle(uint8_t style) {
+    this->style = style;
+    for (uint8_t i = 0; i < rowCount; i++) {
+        rows[i].shownValid = false; // Style is part of every row frame
+        pending |= 1 << i;
+    }
+    sender.send();
+}
+
+/*!
+  * @brief Lay out a new text and send the rows that changed.
+  * @param text 
+      Text to show, words are separated by spaces.
+  * @return true if the whole text is shown, false if it had to be cut.
+  
+  * @note Words longer than the narrowest row are split.
+  * @note Never blocks, changed rows are queued one at a time and count as shown once acknowledged.
+!*/
+bool SAAB_HPD_TextLayout::setText(const char* text) {
+    if (rowCount == 0) {
+        return false;
+    }
+    if (text == nullptr) text = "";
+
+    bool complete = true;
+    uint8_t narrowest = LAYOUT_MAX_ROW_CHARS;
+    for (uint8_t r = 0; r < rowCount; r++) {
+        if (capacity(r) < narrowest) narrowest = capacity(r);
+    }
+    if (narrowest == 0) narrowest = 1;
+
+    // Split into words, words wider than the narrowest row become several pieces
+    uint8_t wordStart[LAYOUT_MAX_WORDS];
+    uint8_t wordLength[LAYOUT_MAX_WORDS];
+    uint8_t words = 0;
+    size_t i = 0;
+    while (text[i] && i < LAYOUT_MAX_TEXT) {
+        if (text[i] == ' ') {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (text[i] && text[i] != ' ' && i < LAYOUT_MAX_TEXT && i - start < narrowest) i++;
+        if (words == LAYOUT_MAX_WORDS) {
+            complete = false;
+            break;
+        }
+        wordStart[words] = start;
+        wordLength[words] = i - start;
+        words++;
+    }
+    if (i >= LAYOUT_MAX_TEXT && text[i]) complete = false;
+
+    uint16_t total = 0;
+    for (uint8_t w = 0; w < words; w++) total += wordLength[w] + (w ? 1 : 0);
+
+    // As few rows as possible, the first one alone if the text fits it
+    uint8_t firstWord[LAYOUT_MAX_ROWS + 1];
+    uint8_t used = 0;
+    if (total <= capacity(0)) {
+        used = words ? 1 : 0;
+        firstWord[0] = 0;
+        firstWord[1] = words;
+    } else {
+        for (uint8_t k = 2; k <= rowCount && used == 0; k++) {
+            if (breakLines(wordLength, words, k, firstWord)) used = k;
+        }
+        if (used == 0) {
+            // Does not fit, fill the rows greedily and cut the rest
+            complete = false;
+            uint8_t w = 0;
+            for (uint8_t r = 0; r < rowCount; r++) {
+                firstWord[r] = w;
+                uint16_t len = 0;
+                while (w < words && len + (len ? 1 : 0) + wordLength[w] <= capacity(r)) {
+                    len += (len ? 1 : 0) + wordLength[w];
+                    w++;
+                }
+            }
+            firstWord[rowCount] = w;
+            used = rowCount;
+        }
+    }
+    rowsUsed = used;
+
+    // Row texts, then mark the rows that differ from the SID
+    for (uint8_t r = 0; r < rowCount; r++) {
+        char* out = rows[r].text;
+        uint8_t n = 0;
+        if (r < used) {
+            for (uint8_t w = firstWord[r]; w < firstWord[r + 1]; w++) {
+                if (n) out[n++] = ' ';
+                memcpy(&out[n], &text[wordStart[w]], wordLength[w]);
+                n += wordLength[w];
+            }
+        }
+        out[n] = '\0';
+        if (!rows[r].shownValid || strcmp(out, rows[r].shown) != 0) {
+            pending |= 1 << r;
+        } else {
+            pending &= ~(1 << r);
+        }
+    }
+    sender.send();
+    return complete;
+}
+
+const char* SAAB_HPD_TextLayout::getRowText(uint8_t row) {
+    return row < rowCount ? rows[row].text : nullptr;
+}
+
+uint8_t SAAB_HPD_TextLayout::getRowsUsed() {
+    return rowsUsed;
+}
+
+uint32_t SAAB_HPD_TextLayout::getFramesSent() {
+    return framesSent;
+}
+
+uint8_t SAAB_HPD_TextLayout::charWidth(uint8_t fontStyle) {
+    if (fontStyle == HPD_FONT_LARGE) return widthLarge;
+    if (fontStyle == HPD_FONT_MEDIUM) return widthMedium;
+    return widthSmall;
+}
+
+uint8_t SAAB_HPD_TextLayout::capacity(uint8_t row) {
+    uint16_t chars = rows[row].width / charWidth(rows[row].fontStyle);
+    return chars < LAYOUT_MAX_ROW_CHARS ? chars : LAYOUT_MAX_ROW_CHARS;
+}
+
+/*!
+  * @brief Break the words over exactly rowsToUse rows with the most even fill.
+  * @return true if a layout exists, firstWord[r] is then the first word of row r and firstWord[rowsToUse] the word count.
+  
+  * @note Minimises the sum of squared free characters per row, a small dynamic program over (row, word).
+!*/
+bool SAAB_HPD_TextLayout::breakLines(const uint8_t wordLength[], uint8_t words, uint8_t rowsToUse, uint8_t firstWord[]) {
+    const uint32_t none = 0xFFFFFFFFUL;
+    uint32_t cost[LAYOUT_MAX_ROWS + 1][LAYOUT_MAX_WORDS + 1];
+    uint8_t next[LAYOUT_MAX_ROWS][LAYOUT_MAX_WORDS + 1];
+
+    for (uint8_t w = 0; w <= words; w++) cost[rowsToUse][w] = w == words ? 0 : none;
+
+    for (int8_t r = rowsToUse - 1; r >= 0; r--) {
+        uint8_t cap = capacity(r);
+        for (uint8_t w = 0; w <= words; w++) {
+            cost[r][w] = none;
+            uint16_t len = 0;
+            for (uint8_t end = w + 1; end <= words; end++) {
+                len += wordLength[end - 1] + (end - 1 > w ? 1 : 0);
+                if (len > cap) break;
+                if (cost[r + 1][end] == none) continue;
+                uint32_t slack = cap - len;
+                uint32_t c = slack * slack + cost[r + 1][end];
+                if (c < cost[r][w]) {
+                    cost[r][w] = c;
+                    next[r][w] = end;
+                }
+            }
+        }
+    }
+
+    if (cost[0][0] == none) {
+        return false;
+    }
+    uint8_t w = 0;
+    for (uint8_t r = 0; r < rowsToUse; r++) {
+        firstWord[r] = w;
+        w = next[r][w];
+    }
+    firstWord[rowsToUse] = w;
+    return true;
+}
+
+// Builds the frame of the next changed row, one is in flight at a time
+bool SAAB_HPD_TextLayout::fillFrame(void* context, SAAB_HPD::SerialFrame &frame) {
+    SAAB_HPD_TextLayout* layout = static_cast<SAAB_HPD_TextLayout*>(context);
+    if (!layout->pending) {
+        return false;
+    }
+    uint8_t r = 0;
+    while (!(layout->pending & (1 << r))) r++;
+
+    Row &row = layout->rows[r];
+    SAAB_HPD::buildChangeRegion(frame, layout->regionID, row.subRegionID0, row.subRegionID1,
+                                row.text[0] ? HPD_VISIBLE : HPD_HIDDEN, layout->style, row.text);
+    layout->inFlight = r;
+    layout->inFlightStyle = layout->style;
+    strcpy(layout->inFlightText, row.text);
+    layout->framesSent++;
+    return true;
+}
+
+// A row only counts as shown once the SID acknowledged it, anything else sends it again
+void SAAB_HPD_TextLayout::onDone(void* context, SAAB_HPD::ERROR result) {
+    SAAB_HPD_TextLayout* layout = static_cast<SAAB_HPD_TextLayout*>(context);
+    uint8_t r = layout->inFlight;
+    layout->inFlight = -1;
+    Row &row = layout->rows[r];
+    if (result != SAAB_HPD::ERROR_OK) {
+        row.shownValid = false;
+        layout->pending |= 1 << r;
+        return;
+    }
+
+    strcpy(row.shown, layout->inFlightText);
+    row.shownValid = layout->inFlightStyle == layout->style; // setStyle() while in flight sends the row again
+    if (row.shownValid && strcmp(row.text, row.shown) == 0) {
+        layout->pending &= ~(1 << r);
+    } else {
+        layout->pending |= 1 << r;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SAAB_HPD_TEXTLAYOUT_H
+#define SAAB_HPD_TEXTLAYOUT_H
+
+#include <SAAB_HPD.h>
+#include <SAAB_HPD_Sender.h>
+
+// Rows a text can be wrapped over
+#define LAYOUT_MAX_ROWS 4
+
+// Longest text and longest row, in characters
+#define LAYOUT_MAX_TEXT 128
+#define LAYOUT_MAX_ROW_CHARS 48
+
+// Words considered by the line balancing, longer texts are cut
+#define LAYOUT_MAX_WORDS 32
+
+// Default character advance per font in pixels, measured on the AUX texts, adjust with setCharWidth()
+#define LAYOUT_WIDTH_SMALL 6
+#define LAYOUT_WIDTH_MEDIUM 8
+#define LAYOUT_WIDTH_LARGE 10
+
+// Word-wraps one text over several text sub-regions.
+// A text that fits the first row stays on it, otherwise it uses as few rows as possible with the line
+// lengths balanced. Rows are compared with what the SID shows and only changed rows are sent.
+//
+//   layout.addRow(0x02, 0xDF, 230, HPD_FONT_MEDIUM); // y=31
+//   layout.addRow(0x02, 0xEF, 150, HPD_FONT_SMALL);  // y=54, created by the application
+//   layout.setText("Artist - A long title");
+class SAAB_HPD_TextLayout {
+public:
+    SAAB_HPD_TextLayout(SAAB_HPD &hpd, uint8_t regionID = 0x01);
+
+    bool addRow(uint8_t subRegionID0, uint8_t subRegionID1, uint16_t width, uint8_t fontStyle); // Top to bottom, false when full
+    void setCharWidth(uint8_t fontStyle, uint8_t width);
+    void setStyle(uint8_t style); // HPD_STYLE_* for all rows
+
+    bool setText(const char* text); // false if the text had to be cut
+    const char* getRowText(uint8_t row);
+    uint8_t getRowsUsed();
+    uint32_t getFramesSent();
+
+private:
+    struct Row {
+        uint8_t subRegionID0;
+        uint8_t subRegionID1;
+        uint16_t width;
+        uint8_t fontStyle;
+        char text[LAYOUT_MAX_ROW_CHARS + 1];
+        char shown[LAYOUT_MAX_ROW_CHARS + 1]; // Acknowledged by the SID
+        bool shownValid; // false until the row was acknowledged once
+    };
+
+    SAAB_HPD &hpd;
+    uint8_t regionID;
+    uint8_t style;
+    Row rows[LAYOUT_MAX_ROWS];
+    uint8_t rowCount;
+    uint8_t rowsUsed;
+    uint8_t widthSmall;
+    uint8_t widthMedium;
+    uint8_t widthLarge;
+    uint8_t pending; // Bit per row still to send
+    int8_t inFlight; // Row waiting for its answer, -1 for none
+    uint8_t inFlightStyle;
+    char inFlightText[LAYOUT_MAX_ROW_CHARS + 1];
+    SAAB_HPD_Sender sender;
+    uint32_t framesSent;
+
+    uint8_t charWidth(uint8_t fontStyle);
+    uint8_t capacity(uint8_t row); // Characters that fit the row
+    bool breakLines(const uint8_t wordLength[], uint8_t words, uint8_t rowsToUse, uint8_t firstWord[]);
+    static bool fillFrame(void* context, SAAB_HPD::SerialFrame &frame);
+    static void onDone(void* context, SAAB_HPD::ERROR result);
+};
+
+#endif // SAAB_HPD_TEXTLAYOUT_H
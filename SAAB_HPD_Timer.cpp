@@ -0,0 +1,306 @@
+#include <SAAB_HPD_Timer.h>
+
+// SAAB_HPD_Timer class implementation
+
+#define TIMER_NIL 0xFF
+#define TIMER_LEVEL1_BASE TIMER_LEVEL0_SLOTS
+#define TIMER_LEVEL2_BASE (TIMER_LEVEL0_SLOTS + TIMER_LEVEL_SLOTS)
+#define TIMER_LEVEL2_SHIFT (TIMER_LEVEL0_BITS + TIMER_LEVEL_BITS)
+#define TIMER_RANGE (1UL << (TIMER_LEVEL2_SHIFT + TIMER_LEVEL_BITS))
+
+SAAB_HPD_Timer::SAAB_HPD_Timer(ClockSource clock)
+    : clock(clock), current(clock()), freeList(0), activeCount(0) {
+    for (uint8_t i = 0; i < TIMER_POOL_SIZE; i++) {
+        nodes[i].next = i + 1 < TIMER_POOL_SIZE ? i + 1 : TIMER_NIL;
+        nodes[i].slot = TIMER_SLOTS;
+        nodes[i].callback = nullptr;
+        nodes[i].generation = 0;
+    }
+    memset(heads, TIMER_NIL, sizeof(heads));
+    memset(occupied, 0, sizeof(occupied));
+}
+
+/*!
+  * @brief Replace the time source.
+  * @param clock 
+      Function returning monotonic milliseconds, e.g. millis or a simulated clock.
+  * @return void
+  
+  * @note Scheduled timers keep their remaining time on the new clock.
+!*/
+void SAAB_HPD_Timer::setClock(ClockSource clock) {
+    uint32_t remaining[TIMER_POOL_SIZE];
+    for (uint8_t i = 0; i < TIMER_POOL_SIZE; i++) {
+        if (nodes[i].slot == TIMER_SLOTS) continue;
+        remaining[i] = nodes[i].expiry - current;
+        unlink(i);
+    }
+
+    this->clock = clock;
+    current = clock();
+
+    for (uint8_t i = 0; i < TIMER_POOL_SIZE; i++) {
+        if (nodes[i].slot != TIMER_SLOTS) continue; // Only the ones unlinked above are re-filed
+        if (nodes[i].callback == nullptr) continue;
+        nodes[i].expiry = current + remaining[i];
+        insert(i);
+    }
+}
+
+unsigned long SAAB_HPD_Timer::now() {
+    return clock();
+}
+
+/*!
+  * @brief Run a callback after a delay.
+  * @param delay 
+      Milliseconds from now. The current millisecond counts as processed, so 0 runs it on the first
+      advance() after the clock has moved on, 1 ms later at most.
+  * @param callback 
+      Called from advance() with context.
+  * @param context 
+      Passed to the callback.
+  * @param period 
+      Repeat interval in milliseconds, 0 for a one shot timer.
+  * @return The timer id, 0 when the pool is exhausted.
+!*/
+SAAB_HPD_Timer::TimerId SAAB_HPD_Timer::schedule(uint32_t delay, TimerCallback callback, void* context, uint32_t period) {
+    return scheduleAt(clock() + delay, callback, context, period);
+}
+
+/*!
+  * @brief Run a callback at an absolute time of the clock source.
+  * @return The timer id, 0 when the pool is exhausted.
+  
+  * @note Repeating timers keep their phase, a timer started at a minute boundary with a 60000 ms period stays on minute boundaries.
+!*/
+SAAB_HPD_Timer::TimerId SAAB_HPD_Timer::scheduleAt(uint32_t when, TimerCallback callback, void* context, uint32_t period) {
+    if (freeList == TIMER_NIL || callback == nullptr) {
+        return 0;
+    }
+
+    uint8_t index = freeList;
+    Node &node = nodes[index];
+    freeList = node.next;
+    node.expiry = when;
+    node.period = period;
+    node.callback = callback;
+    node.context = context;
+    insert(index);
+    activeCount++;
+    return ((TimerId)node.generation << 8) | (index + 1);
+}
+
+bool SAAB_HPD_Timer::cancel(TimerId id) {
+    Node* node = lookup(id);
+    if (!node) {
+        return false;
+    }
+    uint8_t index = node - nodes;
+    unlink(index);
+    release(index);
+    return true;
+}
+
+bool SAAB_HPD_Timer::isScheduled(TimerId id) {
+    return lookup(id) != nullptr;
+}
+
+/*!
+  * @brief Run all timers that expired since the last call.
+  * @return void
+  
+  * @note Ticks without timers in the lowest level are skipped, a long gap costs one step per 256 ms at most.
+  * @note A repeating timer that fell behind by several periods runs once and skips the missed ones, its phase stays.
+  * @note Callbacks may schedule and cancel timers, including their own.
+!*/
+void SAAB_HPD_Timer::advance() {
+    uint32_t target = clock();
+
+    while (current != target) {
+        if (activeCount == 0) {
+            current = target;
+            break;
+        }
+
+        // Nothing in level 0, jump to the tick before the next level 0 wrap
+        bool level0Empty = true;
+        for (uint8_t w = 0; w < TIMER_LEVEL0_SLOTS / 32; w++) {
+            if (occupied[w]) {
+                level0Empty = false;
+                break;
+            }
+        }
+        if (level0Empty) {
+            uint32_t wrap = (current | (TIMER_LEVEL0_SLOTS - 1)) + 1;
+            if ((int32_t)(wrap - target) > 0) {
+                current = target;
+                break;
+            }
+            current = wrap - 1;
+        }
+
+        current++;
+
+        // Move the upper level slots that start now down, highest level first
+        if ((current & ((1UL << TIMER_LEVEL2_SHIFT) - 1)) == 0) {
+            cascade(TIMER_LEVEL2_BASE + ((current >> TIMER_LEVEL2_SHIFT) & (TIMER_LEVEL_SLOTS - 1)));
+        }
+        if ((current & (TIMER_LEVEL0_SLOTS - 1)) == 0) {
+            cascade(TIMER_LEVEL1_BASE + ((current >> TIMER_LEVEL0_BITS) & (TIMER_LEVEL_SLOTS - 1)));
+        }
+
+        // Every node in this slot expires on this tick
+        uint16_t slot = current & (TIMER_LEVEL0_SLOTS - 1);
+        while (heads[slot] != TIMER_NIL) {
+            uint8_t index = heads[slot];
+            Node &node = nodes[index];
+            TimerCallback callback = node.callback;
+            void* context = node.context;
+            unlink(index);
+            if (node.period) {
+                node.expiry += node.period;
+                if ((int32_t)(node.expiry - target) <= 0) {
+                    // Fell behind the clock, skip the missed periods but keep the phase
+                    node.expiry += ((target - node.expiry) / node.period + 1) * node.period;
+                }
+                insert(index);
+            } else {
+                release(index);
+            }
+            callback(context);
+        }
+    }
+}
+
+uint32_t SAAB_HPD_Timer::nextDeadline() {
+    if (activeCount == 0) {
+        return TIMER_NO_DEADLINE;
+    }
+
+    uint32_t earliest = TIMER_NO_DEADLINE;
+    bool found = false;
+
+    // Level 0 slots hold a single expiry each
+    int16_t distance = firstOccupied(0, TIMER_LEVEL0_SLOTS, current & (TIMER_LEVEL0_SLOTS - 1));
+    if (distance >= 0) {
+        earliest = current + distance;
+        found = true;
+    }
+
+    // Upper levels, slots in time order until one starts after the earliest found so far
+    // (a slot can also hold nodes parked beyond the wheel, so the first occupied one is not enough)
+    const uint16_t bases[] = {TIMER_LEVEL1_BASE, TIMER_LEVEL2_BASE};
+    const uint8_t shifts[] = {TIMER_LEVEL0_BITS, TIMER_LEVEL2_SHIFT};
+    for (uint8_t level = 0; level < 2; level++) {
+        uint32_t cursor = current >> shifts[level];
+        for (uint16_t distance = 1; distance <= TIMER_LEVEL_SLOTS; distance++) {
+            uint32_t slotStart = (cursor + distance) << shifts[level];
+            if (found && (int32_t)(slotStart - earliest) > 0) break;
+            uint16_t slot = bases[level] + ((cursor + distance) & (TIMER_LEVEL_SLOTS - 1));
+            for (uint8_t i = heads[slot]; i != TIMER_NIL; i = nodes[i].next) {
+                if (!found || (int32_t)(nodes[i].expiry - earliest) < 0) {
+                    earliest = nodes[i].expiry;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    int32_t remaining = (int32_t)(earliest - (uint32_t)clock());
+    return remaining > 0 ? remaining : 0;
+}
+
+uint8_t SAAB_HPD_Timer::getActiveCount() {
+    return activeCount;
+}
+
+SAAB_HPD_Timer::Node* SAAB_HPD_Timer::lookup(TimerId id) {
+    uint8_t index = (id & 0xFF) - 1;
+    if (id == 0 || index >= TIMER_POOL_SIZE) {
+        return nullptr;
+    }
+    Node &node = nodes[index];
+    if (node.slot == TIMER_SLOTS || node.generation != (id >> 8)) {
+        return nullptr;
+    }
+    return &node;
+}
+
+// Files the node by its distance from the current tick
+void SAAB_HPD_Timer::insert(uint8_t index, bool cascading) {
+    Node &node = nodes[index];
+    // The current tick is already processed, except for nodes cascaded down right before it
+    uint32_t earliest = cascading ? current : current + 1;
+    if ((int32_t)(node.expiry - earliest) < 0) {
+        node.expiry = earliest; // Already due, run on the next tick
+    }
+
+    uint32_t delta = node.expiry - current;
+    uint16_t slot;
+    if (delta < TIMER_LEVEL0_SLOTS) {
+        slot = node.expiry & (TIMER_LEVEL0_SLOTS - 1);
+    } else if (delta < (1UL << TIMER_LEVEL2_SHIFT)) {
+        slot = TIMER_LEVEL1_BASE + ((node.expiry >> TIMER_LEVEL0_BITS) & (TIMER_LEVEL_SLOTS - 1));
+    } else if (delta < TIMER_RANGE) {
+        slot = TIMER_LEVEL2_BASE + ((node.expiry >> TIMER_LEVEL2_SHIFT) & (TIMER_LEVEL_SLOTS - 1));
+    } else {
+        // Beyond the wheel, park in the last level 2 slot to come round and file it again from there
+        slot = TIMER_LEVEL2_BASE + (((current >> TIMER_LEVEL2_SHIFT) - 1) & (TIMER_LEVEL_SLOTS - 1));
+    }
+
+    node.slot = slot;
+    node.prev = TIMER_NIL;
+    node.next = heads[slot];
+    if (node.next != TIMER_NIL) {
+        nodes[node.next].prev = index;
+    }
+    heads[slot] = index;
+    occupied[slot >> 5] |= 1UL << (slot & 31);
+}
+
+void SAAB_HPD_Timer::unlink(uint8_t index) {
+    Node &node = nodes[index];
+    if (node.prev != TIMER_NIL) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.slot] = node.next;
+        if (node.next == TIMER_NIL) {
+            occupied[node.slot >> 5] &= ~(1UL << (node.slot & 31));
+        }
+    }
+    if (node.next != TIMER_NIL) {
+        nodes[node.next].prev = node.prev;
+    }
+    node.slot = TIMER_SLOTS;
+}
+
+void SAAB_HPD_Timer::release(uint8_t index) {
+    Node &node = nodes[index];
+    node.callback = nullptr;
+    node.generation = (node.generation + 1) & 0xFFFFFF;
+    node.next = freeList;
+    freeList = index;
+    activeCount--;
+}
+
+void SAAB_HPD_Timer::cascade(uint16_t slot) {
+    uint8_t index = heads[slot];
+    heads[slot] = TIMER_NIL;
+    occupied[slot >> 5] &= ~(1UL << (slot & 31));
+    while (index != TIMER_NIL) {
+        uint8_t next = nodes[index].next;
+        insert(index, true);
+        index = next;
+    }
+}
+
+int16_t SAAB_HPD_Timer::firstOccupied(uint16_t base, uint16_t slots, uint16_t from) {
+    for (uint16_t distance = 1; distance <= slots; distance++) {
+        uint16_t slot = base + ((from + distance) & (slots - 1));
+        if (occupied[slot >> 5] & (1UL << (slot & 31))) {
+            return distance;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,70 @@
+#ifndef SAAB_HPD_TIMER_H
+#define SAAB_HPD_TIMER_H
+
+#include <Arduino.h>
+
+// Timers that can be scheduled at the same time, at most 254
+#define TIMER_POOL_SIZE 32
+
+// Wheel levels in 1 ms ticks: 256 x 1 ms, 64 x 256 ms, 64 x 16.4 s, longer delays are re-filed
+#define TIMER_LEVEL0_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_LEVEL0_SLOTS (1 << TIMER_LEVEL0_BITS)
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_SLOTS (TIMER_LEVEL0_SLOTS + 2 * TIMER_LEVEL_SLOTS)
+
+// nextDeadline() when nothing is scheduled
+#define TIMER_NO_DEADLINE 0xFFFFFFFFUL
+
+// Hierarchical timer wheel with 1 ms resolution.
+// schedule() and cancel() are O(1), nodes come from a fixed pool and are linked into the slots by index.
+// advance() runs everything that expired, SAAB_HPD calls it from poll().
+class SAAB_HPD_Timer {
+public:
+    typedef unsigned long (*ClockSource)(); // Monotonic milliseconds, millis() by default
+    typedef void (*TimerCallback)(void* context);
+    typedef uint32_t TimerId; // 0 is never a valid timer
+
+    SAAB_HPD_Timer(ClockSource clock = millis);
+
+    void setClock(ClockSource clock);
+    unsigned long now(); // Time of the clock source
+
+    TimerId schedule(uint32_t delay, TimerCallback callback, void* context, uint32_t period = 0); // period 0 for one shot
+    TimerId scheduleAt(uint32_t when, TimerCallback callback, void* context, uint32_t period = 0);
+    bool cancel(TimerId id); // false if the timer already ran or was cancelled
+    bool isScheduled(TimerId id);
+
+    void advance(); // Runs the timers that expired up to now()
+    uint32_t nextDeadline(); // ms until the earliest timer, 0 if overdue, TIMER_NO_DEADLINE if none
+    uint8_t getActiveCount();
+
+private:
+    struct Node {
+        uint32_t expiry;
+        uint32_t period;
+        TimerCallback callback;
+        void* context;
+        uint8_t next;
+        uint8_t prev;
+        uint16_t slot; // Slot index while linked, TIMER_SLOTS on the free list
+        uint32_t generation; // Bumped on every free so stale ids do not match, 24 bits are used
+    };
+
+    ClockSource clock;
+    uint32_t current; // Last tick processed
+    Node nodes[TIMER_POOL_SIZE];
+    uint8_t heads[TIMER_SLOTS];
+    uint32_t occupied[(TIMER_SLOTS + 31) / 32];
+    uint8_t freeList;
+    uint8_t activeCount;
+
+    Node* lookup(TimerId id);
+    void insert(uint8_t index, bool cascading = false);
+    void unlink(uint8_t index);
+    void release(uint8_t index);
+    void cascade(uint16_t slot);
+    int16_t firstOccupied(uint16_t base, uint16_t slots, uint16_t from); // Distance to the next non-empty slot, -1 if none
+};
+
+#endif // SAAB_HPD_TIMER_H
@@ -0,0 +1,52 @@
+#ifndef SAAB_HPD_TOKENBUCKET_H
+#define SAAB_HPD_TOKENBUCKET_H
+
+#include <Arduino.h>
+
+// Frame budget of a widget, rate frames per second with bursts of up to burst frames.
+// Time comes from the caller in ms, normally SAAB_HPD_Timer::now().
+class SAAB_HPD_TokenBucket {
+public:
+    SAAB_HPD_TokenBucket(uint8_t rate, uint8_t burst) : rate(rate), burst(burst), tokens(burst), updated(0) {
+    }
+
+    // Tokens earned at the old rate are kept, up to the new burst
+    void setRate(uint8_t rate, uint8_t burst, unsigned long now) {
+        if (rate == 0) rate = 1;
+        if (burst == 0) burst = 1;
+        refill(now);
+        this->rate = rate;
+        this->burst = burst;
+        if (tokens > burst) tokens = burst;
+    }
+
+    // Full bucket, time before now earns nothing
+    void fill(unsigned long now) {
+        tokens = burst;
+        updated = now;
+    }
+
+    // ms until a token is available, 0 when take() may be called
+    uint32_t wait(unsigned long now) {
+        refill(now);
+        return tokens >= 1.0f ? 0 : (uint32_t)((1.0f - tokens) * 1000.0f / rate) + 1;
+    }
+
+    void take() {
+        tokens -= 1.0f;
+    }
+
+private:
+    uint8_t rate;
+    uint8_t burst;
+    float tokens;
+    unsigned long updated;
+
+    void refill(unsigned long now) {
+        tokens += (now - updated) * rate / 1000.0f;
+        updated = now;
+        if (tokens > burst) tokens = burst;
+    }
+};
+
+#endif // SAAB_HPD_TOKENBUCKET_H
@@ -0,0 +1,120 @@
+#include <SAAB_HPD_Writer.h>
+
+// SAAB_HPD_Writer class implementation
+
+SAAB_HPD_Writer::SAAB_HPD_Writer(SAAB_HPD::SerialFrame &frame)
+    : frame(frame), start(frame.dlc), truncated(false) {
+}
+
+/*!
+  * @brief Append one character.
+  * @param c 
+      Character to append.
+  * @return The writer, for chaining.
+  
+  * @note A byte adds itself to the data sum and one to the DLC, so the checksum grows by c + 1.
+!*/
+SAAB_HPD_Writer& SAAB_HPD_Writer::put(char c) {
+    if (room() == 0) {
+        truncated = true;
+        return *this;
+    }
+    frame.data[frame.dlc - 2] = c;
+    frame.dlc++;
+    frame.checksum += (uint8_t)c + 1;
+    return *this;
+}
+
+SAAB_HPD_Writer& SAAB_HPD_Writer::text(const char* s, uint8_t width, bool rightAlign, char pad) {
+    uint8_t len = 0;
+    while (s && s[len] && (width == 0 || len < width)) len++;
+
+    if (rightAlign && width > len) repeat(pad, width - len);
+    for (uint8_t i = 0; i < len; i++) put(s[i]);
+    if (!rightAlign && width > len) repeat(pad, width - len);
+    return *this;
+}
+
+SAAB_HPD_Writer& SAAB_HPD_Writer::number(int32_t value, uint8_t width, char pad) {
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? -(uint32_t)value : value;
+    uint8_t digits = countDigits(magnitude);
+    uint8_t len = digits + (negative ? 1 : 0);
+
+    // Zero padding goes between the sign and the digits
+    if (width > len && pad != '0') repeat(pad, width - len);
+    if (negative) put('-');
+    if (width > len && pad == '0') repeat('0', width - len);
+    writeDigits(magnitude, digits);
+    return *this;
+}
+
+SAAB_HPD_Writer& SAAB_HPD_Writer::fixed(int32_t value, uint8_t decimals) {
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? -(uint32_t)value : value;
+    if (negative) put('-');
+    writeDigits(magnitude / scale, countDigits(magnitude / scale));
+    if (decimals > 0) {
+        put('.');
+        writeDigits(magnitude % scale, decimals);
+    }
+    return *this;
+}
+
+SAAB_HPD_Writer& SAAB_HPD_Writer::time(uint32_t seconds) {
+    uint32_t minutes = seconds / 60;
+    if (minutes > 99) {
+        minutes = 99;
+        seconds = 59;
+    }
+    writeDigits(minutes, 2);
+    put(':');
+    writeDigits(seconds % 60, 2);
+    return *this;
+}
+
+SAAB_HPD_Writer& SAAB_HPD_Writer::repeat(char c, uint8_t count) {
+    while (count--) put(c);
+    return *this;
+}
+
+uint8_t SAAB_HPD_Writer::length() {
+    return frame.dlc - start;
+}
+
+bool SAAB_HPD_Writer::overflow() {
+    return truncated;
+}
+
+uint8_t SAAB_HPD_Writer::room() {
+    return frame.dlc < WRITER_MAX_DLC ? WRITER_MAX_DLC - frame.dlc : 0;
+}
+
+// Writes exactly digits digits (leading zeros included) from the last one backwards, in place
+void SAAB_HPD_Writer::writeDigits(uint32_t value, uint8_t digits) {
+    if (digits > room()) {
+        truncated = true;
+        return; // Never leave half a number
+    }
+    uint8_t* out = &frame.data[frame.dlc - 2];
+    uint8_t sum = 0;
+    for (int8_t i = digits - 1; i >= 0; i--) {
+        out[i] = '0' + value % 10;
+        sum += out[i] + 1;
+        value /= 10;
+    }
+    frame.dlc += digits;
+    frame.checksum += sum;
+}
+
+uint8_t SAAB_HPD_Writer::countDigits(uint32_t value) {
+    uint8_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
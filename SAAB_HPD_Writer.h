@@ -0,0 +1,40 @@
+#ifndef SAAB_HPD_WRITER_H
+#define SAAB_HPD_WRITER_H
+
+#include <SAAB_HPD.h>
+
+// Largest DLC the SID accepts
+#define WRITER_MAX_DLC 0xFE
+
+// Appends formatted text straight into the payload of a built frame, without buffers or allocation.
+// Every byte updates DLC and checksum as it is written, so the frame can go to sendPreparedSidData()
+// or queuePreparedSidData() as soon as the last call returns.
+//
+//   SAAB_HPD::buildChangeRegion(frame, 0x01, 0x02, 0xDF, HPD_VISIBLE, HPD_STYLE_NORMAL);
+//   SAAB_HPD_Writer(frame).time(elapsed).text(" / ").time(duration);
+//   hpd.sendPreparedSidData(frame);
+class SAAB_HPD_Writer {
+public:
+    SAAB_HPD_Writer(SAAB_HPD::SerialFrame &frame); // Frame with a valid DLC and checksum, text is appended
+
+    SAAB_HPD_Writer& put(char c);
+    SAAB_HPD_Writer& text(const char* s, uint8_t width = 0, bool rightAlign = false, char pad = ' '); // Padded or cut to width, 0 for as is
+    SAAB_HPD_Writer& number(int32_t value, uint8_t width = 0, char pad = ' '); // Right aligned in width
+    SAAB_HPD_Writer& fixed(int32_t value, uint8_t decimals); // fixed(1017, 1) writes 101.7
+    SAAB_HPD_Writer& time(uint32_t seconds); // mm:ss, 99:59 at most
+    SAAB_HPD_Writer& repeat(char c, uint8_t count);
+
+    uint8_t length(); // Text bytes written by this writer
+    bool overflow(); // true if anything was cut at WRITER_MAX_DLC
+
+private:
+    SAAB_HPD::SerialFrame &frame;
+    uint8_t start; // DLC when the writer was created
+    bool truncated;
+
+    uint8_t room();
+    void writeDigits(uint32_t value, uint8_t digits);
+    static uint8_t countDigits(uint32_t value);
+};
+
+#endif // SAAB_HPD_WRITER_H
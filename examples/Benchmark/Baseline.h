@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_BASELINE_H
+#define BENCHMARK_BASELINE_H
+
+// Baseline of the benchmark metrics, ESP32 at 240 MHz.
+// A metric fails when it is worse than its limit by more than maxRegressionPct. Change a limit only
+// from the JSON of a known good run on that board, in the same commit as the change that moves it,
+// never to make a failing run pass.
+
+// Tracked metrics, "higherIsBetter" metrics fail below the limit, the others above it
+struct Metric {
+    const char* name;
+    const char* unit;
+    bool higherIsBetter;
+    float limit;
+    float maxRegressionPct;
+};
+
+const Metric metrics[] = {
+    {"rx_parse_synthetic", "bytes/s", true, 2000000.0f, 10.0f},
+    {"rx_parse_recorded", "bytes/s", true, 2000000.0f, 10.0f},
+    {"encode_0x10_make_region", "us/frame", false, 5.0f, 10.0f},
+    {"encode_0x11_change_region", "us/frame", false, 5.0f, 10.0f},
+    {"encode_0x60_clear_region", "us/frame", false, 2.0f, 10.0f},
+    {"encode_0x70_draw_region", "us/frame", false, 2.0f, 10.0f},
+    {"process_mode", "ns/frame", false, 500.0f, 10.0f},
+    {"process_mode_switch", "ns/frame", false, 1000.0f, 10.0f},
+    {"aux_rebuild", "ms", false, 400.0f, 10.0f},
+    {"text_update", "ms", false, 15.0f, 10.0f},
+};
+const size_t metricCount = sizeof(metrics) / sizeof(metrics[0]);
+
+#endif // BENCHMARK_BASELINE_H
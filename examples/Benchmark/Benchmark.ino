@@ -0,0 +1,248 @@
+/*
+  SAAB_HPD benchmark
+
+  Measures the cost of the library hot paths and prints one JSON object per metric on Serial,
+  followed by a final {"result":...} line. A metric fails when it is worse than its limit by more
+  than the allowed regression, so a CI job or a script on the serial port only has to look for
+  "result":"pass".
+
+  Parse, encode and processMode metrics run without a SID attached. process_mode is mode detection on
+  steady traffic, process_mode_switch adds the EVENT_MODE_CHANGED queued when every frame switches mode.
+  AUX rebuild and text update metrics need a SID (or the simulator) on Serial2, they are reported
+  as "skipped" when nothing answers.
+
+  Limits are kept in Baseline.h next to this sketch.
+*/
+
+#include <SAAB_HPD.h>
+#include "Baseline.h"
+
+#define SID_RX_PIN 16
+#define SID_TX_PIN 17
+
+#define SYNTHETIC_FRAMES 2000
+#define ENCODE_ITERATIONS 2000
+#define RECORDED_ITERATIONS 200
+
+SAAB_HPD hpd(Serial2);
+
+// ICM traffic seen while the head unit sets up the AUX screen, including the SID answers.
+const uint8_t recordedTrace[] = {
+    0x02, 0x81, 0x00, 0x83,
+    0x04, 0x82, 0x00, 0x01, 0x00, 0x87,
+    0x02, 0x83, 0x00, 0x85,
+    0x04, 0x84, 0x00, 0x00, 0x40, 0xC8,
+    0x05, 0x60, 0x00, 0x01, 0x00, 0x00, 0x66,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0D, 0x10, 0x00, 0x01, 0x00, 0x00, 0x3C, 0x01, 0x01, 0x08, 0x00, 0xBB, 0x00, 0x22, 0x41,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0D, 0x10, 0x00, 0x01, 0x00, 0x00, 0x3D, 0x01, 0x01, 0x14, 0x00, 0xFC, 0x00, 0x1F, 0x8C,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0D, 0x10, 0x00, 0x01, 0x00, 0x00, 0x3E, 0x01, 0x01, 0x2C, 0x00, 0xCF, 0x00, 0x1F, 0x78,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0F, 0x10, 0x00, 0x01, 0x00, 0x02, 0xCD, 0x01, 0x01, 0x1E, 0x00, 0x8E, 0x00, 0x22, 0x42, 0x54, 0x55,
+    0x02, 0xFF, 0x00, 0x01,
+    0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0xDF, 0x01, 0x02, 0xE6, 0x00, 0xBB, 0x00, 0x1F, 0x50, 0x6C, 0x61, 0x79, 0x5C,
+    0x02, 0xFF, 0x00, 0x01,
+    0x05, 0x70, 0x00, 0x01, 0x00, 0x01, 0x77,
+    0x02, 0xFF, 0x00, 0x01,
+    0x14, 0x11, 0x00, 0x00, 0x00, 0x00, 0x13, 0x02, 0x00, 0x46, 0x4D, 0x31, 0x20, 0x50, 0x33, 0x20, 0x31, 0x30, 0x31, 0x2E, 0x37, 0xB8,
+    0x02, 0xFF, 0x00, 0x01,
+    0x08, 0x11, 0x00, 0x01, 0x00, 0x02, 0xCD, 0x02, 0x00, 0xEB,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0C, 0x11, 0x00, 0x01, 0x00, 0x02, 0xDF, 0x02, 0x00, 0x50, 0x6C, 0x61, 0x79, 0x97,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0C, 0x11, 0x00, 0x01, 0x00, 0x00, 0x3D, 0x02, 0x10, 0x33, 0x3A, 0x32, 0x37, 0x43,
+    0x02, 0xFF, 0x00, 0x01,
+    0x0C, 0x11, 0x00, 0x01, 0x00, 0x00, 0x3D, 0x02, 0x10, 0x33, 0x3A, 0x32, 0x38, 0x44,
+    0x02, 0xFF, 0x00, 0x01,
+    0x04, 0x80, 0x00, 0x40, 0x40, 0x04,
+    0x02, 0xFF, 0x00, 0x01,
+};
+
+bool benchFailed = false;
+volatile uint32_t framesSeen = 0; // Keeps the callback from being optimized out
+
+void countFrame(const SAAB_HPD::SerialFrame &frame) {
+    framesSeen++;
+}
+
+void report(const char* name, float value, bool skipped = false) {
+    for (size_t i = 0; i < metricCount; i++) {
+        const Metric &m = metrics[i];
+        if (strcmp(m.name, name) != 0) continue;
+
+        const char* status = "skipped";
+        if (!skipped) {
+            float allowed = m.higherIsBetter ? m.limit * (1.0f - m.maxRegressionPct / 100.0f)
+                                             : m.limit * (1.0f + m.maxRegressionPct / 100.0f);
+            bool pass = m.higherIsBetter ? value >= allowed : value <= allowed;
+            status = pass ? "pass" : "fail";
+            if (!pass) benchFailed = true;
+        }
+        Serial.printf("{\"metric\":\"%s\",\"value\":%.3f,\"unit\":\"%s\",\"limit\":%.3f,\"max_regression_pct\":%.1f,\"status\":\"%s\"}\n",
+                      m.name, skipped ? 0.0f : value, m.unit, m.limit, m.maxRegressionPct, status);
+        return;
+    }
+}
+
+// Builds a stream of valid 0x11 frames with varying sub-regions and text, preceded by the sync pattern.
+// With out == nullptr only the length is returned, so the buffer can be sized to the real frames.
+size_t buildSyntheticTraffic(uint8_t* out, size_t frames) {
+    size_t len = 0;
+    if (out) memcpy(out, syncPattern, syncPatternLength);
+    len += syncPatternLength;
+
+    SAAB_HPD::SerialFrame frame;
+    uint8_t wire[BUFFER_SIZE + 2];
+    char text[24];
+    for (size_t i = 0; i < frames; i++) {
+        snprintf(text, sizeof(text), "Track %u", (unsigned)(i % 1000));
+        SAAB_HPD::buildChangeRegion(frame, 0x01, 0x02, 0xBF + (i % 0x20), HPD_VISIBLE, HPD_STYLE_NORMAL, text);
+        size_t frameLen = SAAB_HPD::serializeFrame(frame, wire);
+        if (out) memcpy(&out[len], wire, frameLen);
+        len += frameLen;
+    }
+    return len;
+}
+
+void benchParse(const char* name, const uint8_t* data, size_t len, uint32_t iterations) {
+    SAAB_HPD parser(Serial2);
+    SAAB_HPD::SerialFrame frame;
+    uint32_t frames = 0;
+
+    unsigned long start = micros();
+    for (uint32_t n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < len; i++) {
+            if (parser.parseByte(data[i], frame)) frames++;
+        }
+    }
+    unsigned long elapsed = micros() - start;
+
+    framesSeen += frames;
+    report(name, (float)len * iterations * 1000000.0f / (elapsed ? elapsed : 1));
+}
+
+void benchEncode() {
+    SAAB_HPD::SerialFrame frame;
+    uint8_t wire[BUFFER_SIZE + 2];
+    volatile size_t sink = 0;
+    unsigned long start;
+
+    start = micros();
+    for (int i = 0; i < ENCODE_ITERATIONS; i++) {
+        SAAB_HPD::buildMakeRegion(frame, 0x01, 0x02, 0xDF, 187, 31, 230, HPD_FONT_MEDIUM, "Play");
+        sink += SAAB_HPD::serializeFrame(frame, wire);
+    }
+    report("encode_0x10_make_region", (float)(micros() - start) / ENCODE_ITERATIONS);
+
+    start = micros();
+    for (int i = 0; i < ENCODE_ITERATIONS; i++) {
+        SAAB_HPD::buildChangeRegion(frame, 0x01, 0x02, 0xDF, HPD_VISIBLE, HPD_STYLE_NORMAL, "Artist - Title");
+        sink += SAAB_HPD::serializeFrame(frame, wire);
+    }
+    report("encode_0x11_change_region", (float)(micros() - start) / ENCODE_ITERATIONS);
+
+    start = micros();
+    for (int i = 0; i < ENCODE_ITERATIONS; i++) {
+        SAAB_HPD::buildClearRegion(frame, 0x01, 0x00);
+        sink += SAAB_HPD::serializeFrame(frame, wire);
+    }
+    report("encode_0x60_clear_region", (float)(micros() - start) / ENCODE_ITERATIONS);
+
+    start = micros();
+    for (int i = 0; i < ENCODE_ITERATIONS; i++) {
+        SAAB_HPD::buildDrawRegion(frame, 0x01, 0x01);
+        sink += SAAB_HPD::serializeFrame(frame, wire);
+    }
+    report("encode_0x70_draw_region", (float)(micros() - start) / ENCODE_ITERATIONS);
+}
+
+// processMode() is private, it changes the mode and queues events of the instance it runs on
+struct SAAB_HPD_BenchmarkHook {
+    static void processMode(SAAB_HPD &detector, const SAAB_HPD::SerialFrame &frame) {
+        detector.processMode(frame);
+    }
+};
+
+void benchProcessMode() {
+    SAAB_HPD detector(Serial2); // Not the live instance, its events would reach the application
+    const uint32_t iterations = 20000;
+
+    // AUX screen traffic, every branch of the detection runs but the mode stays
+    SAAB_HPD::SerialFrame frames[4];
+    SAAB_HPD::buildChangeRegion(frames[0], 0x01, 0x02, 0xCD, HPD_VISIBLE, HPD_STYLE_NORMAL);
+    SAAB_HPD::buildChangeRegion(frames[1], 0x01, 0x02, 0xDF, HPD_VISIBLE, HPD_STYLE_NORMAL, "Play");
+    SAAB_HPD::buildChangeRegion(frames[2], 0x00, 0x00, 0x13, HPD_VISIBLE, HPD_STYLE_NORMAL, "P3 101.7");
+    SAAB_HPD::buildDrawRegion(frames[3], 0x01, 0x01);
+    SAAB_HPD_BenchmarkHook::processMode(detector, frames[0]);
+    detector.clearEvents();
+
+    unsigned long start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+        SAAB_HPD_BenchmarkHook::processMode(detector, frames[i & 0x03]);
+    }
+    unsigned long elapsed = micros() - start;
+    report("process_mode", (float)elapsed * 1000.0f / iterations);
+
+    // AUX and FM1 in turn, each frame queues EVENT_MODE_CHANGED. The queue is emptied every 4 frames
+    // like poll() delivers it, so every frame pays for its event instead of hitting a full queue
+    SAAB_HPD::buildChangeRegion(frames[1], 0x00, 0x00, 0x13, HPD_VISIBLE, HPD_STYLE_NORMAL, "FM1 101.7");
+    start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+        SAAB_HPD_BenchmarkHook::processMode(detector, frames[i & 0x01]);
+        if ((i & 0x03) == 0x03) detector.clearEvents();
+    }
+    elapsed = micros() - start;
+    report("process_mode_switch", (float)elapsed * 1000.0f / iterations);
+}
+
+void benchBus() {
+    if (hpd.drawRegion(0x01, 0x01) == SAAB_HPD::ERROR_TIMEOUT) {
+        report("aux_rebuild", 0, true);
+        report("text_update", 0, true);
+        return;
+    }
+
+    unsigned long start = millis();
+    bool rebuilt = hpd.recreateAuxRegion();
+    unsigned long elapsed = millis() - start;
+    report("aux_rebuild", elapsed, !rebuilt);
+
+    const int updates = 20;
+    char text[24];
+    start = millis();
+    for (int i = 0; i < updates; i++) {
+        snprintf(text, sizeof(text), "Bench %02d", i);
+        hpd.changeRegion(0x01, 0x02, 0xDF, HPD_VISIBLE, HPD_STYLE_NORMAL, text);
+    }
+    report("text_update", (float)(millis() - start) / updates);
+}
+
+void setup() {
+    Serial.begin(115200);
+    hpd.begin(SID_RX_PIN, SID_TX_PIN);
+    hpd.setFrameCallback(countFrame);
+    delay(500);
+
+    // About 20 bytes per frame, fits the heap of an ESP32 without PSRAM
+    size_t syntheticSize = buildSyntheticTraffic(nullptr, SYNTHETIC_FRAMES);
+    uint8_t* synthetic = (uint8_t*)malloc(syntheticSize);
+    if (synthetic == nullptr) {
+        Serial.println("{\"result\":\"error\",\"reason\":\"out of memory\"}");
+        return;
+    }
+    size_t syntheticLen = buildSyntheticTraffic(synthetic, SYNTHETIC_FRAMES);
+    benchParse("rx_parse_synthetic", synthetic, syntheticLen, 1);
+    free(synthetic);
+
+    benchParse("rx_parse_recorded", recordedTrace, sizeof(recordedTrace), RECORDED_ITERATIONS);
+    benchEncode();
+    benchProcessMode();
+    benchBus();
+
+    Serial.printf("{\"result\":\"%s\",\"frames\":%u}\n", benchFailed ? "fail" : "pass", (unsigned)framesSeen);
+}
+
+void loop() {
+}
@@ -0,0 +1,77 @@
+/*
+  SAAB_HPD 0x40 probe
+
+  EXPERIMENTAL: the payload of command 0x40 is not documented. This sketch sends a few test
+  patterns in every candidate layout of SAAB_HPD_Framebuffer and prints one JSON object per
+  attempt with the SID answer (0 = ACK, -1 = timeout, other values are the NACK code), followed
+  by a summary table. Watch the display while it runs, every pattern stays up for PATTERN_HOLD_MS.
+
+  SID on Serial2. Only try this on a bench SID.
+*/
+
+#include <SAAB_HPD_Framebuffer.h>
+
+#define SID_RX_PIN 16
+#define SID_TX_PIN 17
+
+#define PATTERN_HOLD_MS 3000
+
+SAAB_HPD hpd(Serial2);
+
+const uint8_t regions[] = {0x00, 0x01, 0x02};
+const char* formatNames[] = {"rows", "pages", "columns"};
+const char* patternNames[] = {"square", "line", "full"};
+
+#define REGION_COUNT (sizeof(regions) / sizeof(regions[0]))
+#define FORMAT_COUNT 3
+#define PATTERN_COUNT 3
+
+int results[REGION_COUNT][FORMAT_COUNT][PATTERN_COUNT];
+
+void drawPattern(SAAB_HPD_Framebuffer &fb, uint8_t pattern) {
+    if (pattern == 0) {
+        // 16x16 checkerboard in the top left corner
+        for (int16_t y = 0; y < 16; y++) {
+            for (int16_t x = 0; x < 16; x++) {
+                fb.setPixel(x, y, ((x / 4) + (y / 4)) & 1);
+            }
+        }
+    } else if (pattern == 1) {
+        // Full width line through the middle
+        fb.fillRect(0, 32, FRAMEBUFFER_WIDTH, 2, true);
+    } else {
+        fb.clear(true);
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+    hpd.begin(SID_RX_PIN, SID_TX_PIN);
+
+    for (uint8_t r = 0; r < REGION_COUNT; r++) {
+        for (uint8_t f = 0; f < FORMAT_COUNT; f++) {
+            for (uint8_t p = 0; p < PATTERN_COUNT; p++) {
+                SAAB_HPD_Framebuffer fb(hpd, regions[r], (SAAB_HPD_Framebuffer::RAW_FORMAT)f);
+                drawPattern(fb, p);
+                SAAB_HPD::ERROR result = fb.flush();
+                results[r][f][p] = result;
+                Serial.printf("{\"region\":%u,\"format\":\"%s\",\"pattern\":\"%s\",\"frames\":%lu,\"bytes\":%lu,\"result\":%d}\n",
+                              regions[r], formatNames[f], patternNames[p],
+                              (unsigned long)fb.getFramesSent(), (unsigned long)fb.getBytesSent(), result);
+                delay(PATTERN_HOLD_MS);
+            }
+        }
+    }
+
+    Serial.println("region  format   square  line  full");
+    for (uint8_t r = 0; r < REGION_COUNT; r++) {
+        for (uint8_t f = 0; f < FORMAT_COUNT; f++) {
+            Serial.printf("0x%02X    %-7s  %6d  %4d  %4d\n", regions[r], formatNames[f],
+                          results[r][f][0], results[r][f][1], results[r][f][2]);
+        }
+    }
+}
+
+void loop() {
+    hpd.poll();
+}
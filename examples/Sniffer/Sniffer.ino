@@ -0,0 +1,30 @@
+/*
+  SAAB_HPD sniffer
+
+  Taps both directions of the ICM <-> SID line and prints a table of ICM commands with the
+  SID answer latency and error codes every 5 seconds.
+
+  Serial1 RX on the ICM -> SID line, Serial2 RX on the SID -> ICM line.
+*/
+
+#include <SAAB_HPD_Sniffer.h>
+
+#define ICM_LINE_RX_PIN 4
+#define SID_LINE_RX_PIN 16
+
+SAAB_HPD_Sniffer sniffer(Serial1, Serial2);
+unsigned long lastPrint = 0;
+
+void setup() {
+    Serial.begin(115200);
+    sniffer.begin(ICM_LINE_RX_PIN, SID_LINE_RX_PIN);
+}
+
+void loop() {
+    sniffer.poll();
+
+    if (millis() - lastPrint >= 5000) {
+        lastPrint = millis();
+        sniffer.printTable();
+    }
+}
@@ -0,0 +1,140 @@
+-- Wireshark dissector for SAAB SID HPD UART frames
+--
+-- Captures written by SAAB_HPD_Pcapng use LINKTYPE_USER0 (147), one packet per frame.
+-- Install: copy this file into the Wireshark personal plugins folder
+-- (Help > About Wireshark > Folders > Personal Lua Plugins) and reload (Ctrl+Shift+L).
+--
+-- Frame format, see UART_PROTOCOL.md:
+--   DLC(1) COMMAND(1) 0x00 DATA(DLC-2) CHECKSUM(1), checksum = sum of all previous bytes & 0xFF
+
+local sid = Proto("sid_hpd", "SAAB SID HPD")
+
+local commands = {
+    [0x10] = "Setup sub-region",
+    [0x11] = "Update sub-region",
+    [0x20] = "Group sub-regions",
+    [0x21] = "Move group",
+    [0x30] = "Setup icon",
+    [0x33] = "Car door state",
+    [0x40] = "Raw display data",
+    [0x60] = "Clear region",
+    [0x70] = "Draw region",
+    [0x80] = "Backlight",
+    [0x81] = "Status query",
+    [0x82] = "Status reply",
+    [0x83] = "Status query 2",
+    [0x84] = "Status reply 2",
+    [0x94] = "Serial query",
+    [0x95] = "Serial reply",
+    [0x96] = "Serial query 2",
+    [0x97] = "Serial reply 2",
+    [0x9F] = "Self test",
+    [0xA0] = "Setup/reset",
+    [0xC0] = "Display off",
+    [0xFE] = "Error",
+    [0xFF] = "OK",
+}
+
+local errors = {
+    [0x31] = "Invalid command",
+    [0x33] = "Region already exists",
+    [0x34] = "Invalid arguments/length",
+    [0x35] = "Unknown 0x35",
+    [0x37] = "Unknown 0x37",
+}
+
+local fonts = {
+    [0x00] = "Small",
+    [0x01] = "Large",
+    [0x02] = "Medium",
+    [0x04] = "Time (left digits)",
+    [0x14] = "Time (right digits)",
+}
+
+local f = sid.fields
+f.dlc = ProtoField.uint8("sid_hpd.dlc", "DLC", base.HEX)
+f.command = ProtoField.uint8("sid_hpd.command", "Command", base.HEX, commands)
+f.padding = ProtoField.uint8("sid_hpd.padding", "Padding", base.HEX)
+f.data = ProtoField.bytes("sid_hpd.data", "Data")
+f.region = ProtoField.uint8("sid_hpd.region", "Region", base.HEX)
+f.subregion = ProtoField.uint16("sid_hpd.subregion", "Sub-region", base.HEX)
+f.visibility = ProtoField.uint8("sid_hpd.visibility", "Visibility", base.HEX)
+f.style = ProtoField.uint8("sid_hpd.style", "Style", base.HEX)
+f.font = ProtoField.uint8("sid_hpd.font", "Font", base.HEX, fonts)
+f.width = ProtoField.uint8("sid_hpd.width", "Width", base.DEC)
+f.xpos = ProtoField.uint16("sid_hpd.x", "X position", base.DEC)
+f.ypos = ProtoField.uint8("sid_hpd.y", "Y position", base.DEC)
+f.flag = ProtoField.uint8("sid_hpd.flag", "Flag", base.HEX)
+f.text = ProtoField.string("sid_hpd.text", "Text")
+f.error = ProtoField.uint8("sid_hpd.error", "Error", base.HEX, errors)
+f.checksum = ProtoField.uint8("sid_hpd.checksum", "Checksum", base.HEX)
+f.checksum_ok = ProtoField.bool("sid_hpd.checksum_ok", "Checksum valid")
+
+local direction = Field.new("frame.packet_flags_direction")
+
+function sid.dissector(buffer, pinfo, tree)
+    local len = buffer:len()
+    if len < 3 then return 0 end
+
+    pinfo.cols.protocol = "SID HPD"
+
+    local dlc = buffer(0, 1):uint()
+    local command = buffer(1, 1):uint()
+    local subtree = tree:add(sid, buffer(), "SAAB SID HPD frame")
+    subtree:add(f.dlc, buffer(0, 1))
+    subtree:add(f.command, buffer(1, 1))
+
+    local dataStart = 2
+    if dlc >= 2 and len > 3 then
+        subtree:add(f.padding, buffer(2, 1))
+        dataStart = 3
+    end
+    local dataLength = len - dataStart - 1
+    if dataLength > 0 then
+        local data = buffer(dataStart, dataLength)
+        subtree:add(f.data, data)
+
+        if (command == 0x10 or command == 0x11 or command == 0x30 or command == 0x33) and dataLength >= 4 then
+            subtree:add(f.region, data(0, 1))
+            subtree:add(f.subregion, data(2, 2))
+        elseif (command == 0x60 or command == 0x70) and dataLength >= 3 then
+            subtree:add(f.region, data(0, 1))
+            subtree:add(f.flag, data(2, 1))
+        elseif command == 0xFE then
+            subtree:add(f.error, data(0, 1))
+        end
+
+        if command == 0x10 and dataLength >= 11 then
+            subtree:add(f.font, data(5, 1))
+            subtree:add(f.width, data(6, 1))
+            subtree:add_le(f.xpos, data(8, 2))
+            subtree:add(f.ypos, data(10, 1))
+            if dataLength > 11 then subtree:add(f.text, data(11, dataLength - 11)) end
+        elseif command == 0x11 and dataLength >= 6 then
+            subtree:add(f.visibility, data(4, 1))
+            subtree:add(f.style, data(5, 1))
+            if dataLength > 6 then subtree:add(f.text, data(6, dataLength - 6)) end
+        end
+    end
+
+    local sum = 0
+    for i = 0, len - 2 do sum = sum + buffer(i, 1):uint() end
+    local checksum = buffer(len - 1, 1)
+    subtree:add(f.checksum, checksum)
+    subtree:add(f.checksum_ok, (sum % 256) == checksum:uint())
+
+    local dir = direction()
+    local arrow = ""
+    if dir then
+        arrow = (dir.value == 1) and "RX " or ((dir.value == 2) and "TX " or "")
+    end
+    local info = arrow .. (commands[command] or string.format("Command 0x%02X", command))
+    if command == 0xFE and dataLength > 0 then
+        local code = buffer(dataStart, 1):uint()
+        info = info .. " " .. (errors[code] or string.format("0x%02X", code))
+    end
+    pinfo.cols.info = info
+    return len
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, sid)